@@ -7,44 +7,512 @@
 #include <cstring>
 #include <cassert>
 #include <stdexcept>
-#include <sstream>
 #include <atomic>
+#include <algorithm>
+#include <new>
+#include <thread>
+#include <exception>
+#include <climits>
+#include <cstdio>
+#include <cmath>
+#include <cerrno>
+#include <mutex>
+
+#if !defined(ARGPARSE_NO_SIMD) && defined(__AVX2__)
+#define ARGPARSE_SIMD_AVX2
+#include <immintrin.h>
+#elif !defined(ARGPARSE_NO_SIMD) && defined(__SSE2__)
+#define ARGPARSE_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#define ARGPARSE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace argparse {
 
 namespace detail {
 
-enum class opt_type : std::uint8_t
-{
-    param,
-    flag,
-    category,
-};
+#ifdef ARGPARSE_SINGLE_THREADED
+using ref_count = std::size_t;
+#else
+using ref_count = std::atomic<std::size_t>;
+#endif
 
 struct opt_base::opt_impl
 {
-    std::atomic<std::size_t> ref {1};
-    opt_type type;
-    char shortname {0};
-    const char* longname {nullptr};
+    opt_arena* pool {nullptr};
+    std::uint32_t id {0}; ///< Registration number, index of the option in schema results.
+    opt_spec spec {opt_type::flag, 0, nullptr, 0, value_kind::string, 0, 0};
     const char* desc {nullptr};
-    const char* value {nullptr};
+    const char* metavar {nullptr};
+    opt_slot slot;
+    bool shadowed {false};
+};
+
+/// Loads a file for splitting in place, with one spare byte after its contents.
+/// Returns false if the file can't be read.
+static bool load_file(const char* path, file_buffer& out)
+{
+#ifdef ARGPARSE_POSIX
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // Reserve a writable anonymous region one byte longer than the file and
+    // map the file privately over its start. The spare byte, and the zeroed
+    // rest of the last page, are then valid even if the file size is an exact
+    // multiple of the page size. Writes are copy-on-write, the file is untouched.
+    const std::size_t size = static_cast<std::size_t>(st.st_size);
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t len = (size + 1 + page - 1) / page * page;
+    void* base = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    if (size > 0 && ::mmap(base, size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        ::munmap(base, len);
+        ::close(fd);
+        return false;
+    }
+    ::close(fd);
+    out = file_buffer{static_cast<char*>(base), size, len};
+    return true;
+#else
+    std::FILE* f = std::fopen(path, "rb");
+    if (f == nullptr)
+        return false;
+    std::vector<char> buf;
+    char chunk[65536];
+    std::size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+    bool ok = !std::ferror(f);
+    std::fclose(f);
+    if (!ok)
+        return false;
+    out = file_buffer{new char[buf.size() + 1], buf.size(), 0};
+    std::memcpy(out.data, buf.data(), buf.size());
+    return true;
+#endif
+}
+
+static void free_file(file_buffer& f) noexcept
+{
+#ifdef ARGPARSE_POSIX
+    if (f.mapped != 0) {
+        ::munmap(f.data, f.mapped);
+        f.data = nullptr;
+        return;
+    }
+#endif
+    delete[] f.data;
+    f.data = nullptr;
+}
+
+static bool is_space(char c) noexcept
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// Returns the first whitespace, quote or backslash in [p, end), or end.
+static const char* find_special(const char* p, const char* end) noexcept
+{
+#if defined(ARGPARSE_SIMD_AVX2)
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i four = _mm256_set1_epi8(4);
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        // '\t' ... '\r' are consecutive, c - '\t' <= 4 as unsigned.
+        __m256i ctl = _mm256_sub_epi8(v, tab);
+        __m256i m = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, space), _mm256_cmpeq_epi8(v, squote)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, dquote), _mm256_cmpeq_epi8(v, bslash)));
+        m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_min_epu8(ctl, four), ctl));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(m));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+#elif defined(ARGPARSE_SIMD_SSE2)
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // '\t' ... '\r' are consecutive, c - '\t' <= 4 as unsigned.
+        __m128i ctl = _mm_sub_epi8(v, tab);
+        __m128i m = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(v, space), _mm_cmpeq_epi8(v, squote)),
+                _mm_or_si128(_mm_cmpeq_epi8(v, dquote), _mm_cmpeq_epi8(v, bslash)));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(ctl, four), ctl));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(m));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; ++p)
+        if (is_space(*p) || *p == '\'' || *p == '"' || *p == '\\')
+            return p;
+    return end;
+}
+
+/// Returns the first double quote or backslash in [p, end), or end.
+static const char* find_dquote_special(const char* p, const char* end) noexcept
+{
+#if defined(ARGPARSE_SIMD_AVX2)
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    for (; end - p >= 32; p += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, dquote), _mm256_cmpeq_epi8(v, bslash));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(m));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+#elif defined(ARGPARSE_SIMD_SSE2)
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    for (; end - p >= 16; p += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, dquote), _mm_cmpeq_epi8(v, bslash));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(m));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+#endif
+    for (; p < end; ++p)
+        if (*p == '"' || *p == '\\')
+            return p;
+    return end;
+}
+
+/// Splits buf into arguments in place and appends them to out.
+/// Arguments are separated by whitespace, can be quoted with ' or ", and
+/// backslash escapes the next character outside of single quotes. Unquoted
+/// text is shifted left over removed quotes and escapes, and every argument
+/// is NUL terminated inside the buffer, which needs one spare byte after size.
+/// Runs of plain characters are found in bulk and moved with memmove.
+static void split_in_place(char* buf, std::size_t size, std::vector<const char*>& out)
+{
+    const char* r = buf;
+    const char* end = buf + size;
+    char* w = buf;
+
+    for (;;) {
+        while (r < end && is_space(*r))
+            ++r;
+        if (r == end)
+            break;
+
+        char* arg = w;
+        char quote = 0;
+        for (;;) {
+            const char* s;
+            if (quote == 0)
+                s = find_special(r, end);
+            else if (quote == '"')
+                s = find_dquote_special(r, end);
+            else if ((s = static_cast<const char*>(std::memchr(r, '\'', end - r))) == nullptr)
+                s = end;
+            if (s != r) {
+                if (w != r)
+                    std::memmove(w, r, s - r);
+                w += s - r;
+                r = s;
+            }
+            if (r == end)
+                break;
+
+            char c = *r;
+            if (quote == '\'') {
+                quote = 0;
+                ++r;
+            } else if (c == '\\') {
+                // Trailing backslash is kept as it is.
+                *w++ = r + 1 < end ? r[1] : c;
+                r += r + 1 < end ? 2 : 1;
+            } else if (quote == '"') {
+                quote = 0;
+                ++r;
+            } else if (is_space(c)) {
+                break;
+            } else {
+                quote = c;
+                ++r;
+            }
+        }
+
+        // Step over the separator before terminating, w may be right at it.
+        if (r < end)
+            ++r;
+        *w++ = '\0';
+        out.push_back(arg);
+    }
+}
+
+static void expand_into(const char* const* argv, std::size_t argc, int depth, bool& done,
+        std::vector<const char*>& out, std::vector<file_buffer>& files)
+{
+    for (std::size_t i = 0; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (arg == nullptr)
+            throw std::runtime_error("invalid arg value");
+        if (done || arg[0] != '@' || arg[1] == '\0' || depth >= response_files::max_depth) {
+            done = done || std::strcmp(arg, "--") == 0;
+            out.push_back(arg);
+            continue;
+        }
+
+        file_buffer f;
+        if (!load_file(&arg[1], f)) {
+            out.push_back(arg);
+            continue;
+        }
+        files.push_back(f);
+
+        // Split into a separate list first, out may be the list being expanded.
+        std::vector<const char*> args;
+        split_in_place(f.data, f.size, args);
+        expand_into(args.data(), args.size(), depth + 1, done, out, files);
+    }
+}
+
+/// Expands "@path" arguments of argv[1] ... argv[argc - 1] into out,
+/// which is terminated with nullptr. Loaded files are appended to files.
+static void expand_response_files(int argc, const char* const* argv,
+        std::vector<const char*>& out, std::vector<file_buffer>& files)
+{
+    out.clear();
+    out.push_back(argv[0]);
+    bool done = false;
+    expand_into(argv + 1, static_cast<std::size_t>(argc - 1), 0, done, out, files);
+    if (out.size() > static_cast<std::size_t>(INT_MAX))
+        throw std::length_error("too many arguments");
+    out.push_back(nullptr);
+}
+
+std::size_t list_store::create()
+{
+    lists.push_back(list{});
+    return lists.size() - 1;
+}
+
+void list_store::_push(std::size_t l, item v)
+{
+    list& x = lists[l];
+    if (x.size < inline_size) {
+        x.items[x.size++] = v;
+        return;
+    }
+
+    std::size_t k = x.size - inline_size;
+    if (k == x.spill_cap) {
+        if (x.spill_cap != 0 && x.spill + x.spill_cap == spilled.size()) {
+            // Last block in the array, grow it in place.
+            spilled.resize(spilled.size() + x.spill_cap);
+        } else {
+            std::size_t at = spilled.size();
+            spilled.resize(at + (x.spill_cap != 0 ? x.spill_cap * 2 : inline_size * 2));
+            std::copy(spilled.begin() + x.spill, spilled.begin() + x.spill + k, spilled.begin() + at);
+            x.spill = at;
+        }
+        x.spill_cap = static_cast<std::uint32_t>(x.spill_cap != 0 ? x.spill_cap * 2 : inline_size * 2);
+    }
+    spilled[x.spill + k] = v;
+    ++x.size;
+}
+
+void list_store::add(std::size_t l, const char* value, char delimiter)
+{
+    if (delimiter != 0) {
+        // memchr is vectorized by the C library. The last piece ends where
+        // the value does, so only the pieces before it need a terminated copy.
+        const char* end = value + std::strlen(value);
+        const char* d;
+        while ((d = static_cast<const char*>(std::memchr(value, delimiter, end - value))) != nullptr) {
+            std::size_t offset = bytes.size();
+            bytes.insert(bytes.end(), value, d);
+            bytes.push_back('\0');
+            _push(l, item{nullptr, offset});
+            value = d + 1;
+        }
+    }
+    _push(l, item{value, 0});
+}
+
+const char* list_store::get(std::size_t l, std::size_t i) const noexcept
+{
+    const list& x = lists[l];
+    const item& v = i < inline_size ? x.items[i] : spilled[x.spill + (i - inline_size)];
+    return v.ptr != nullptr ? v.ptr : bytes.data() + v.offset;
+}
+
+void list_store::clear() noexcept
+{
+    lists.clear();
+    spilled.clear();
+    bytes.clear();
+}
+
+std::size_t list_store::append(const list_store& b)
+{
+    const std::size_t first = lists.size();
+    const std::size_t spill_offset = spilled.size();
+    const std::size_t bytes_offset = bytes.size();
+    auto fix = [bytes_offset](item& v) {
+        if (v.ptr == nullptr)
+            v.offset += bytes_offset;
+    };
+
+    lists.insert(lists.end(), b.lists.begin(), b.lists.end());
+    for (std::size_t i = first; i < lists.size(); ++i) {
+        lists[i].spill += spill_offset;
+        for (std::size_t j = 0; j < lists[i].size && j < inline_size; ++j)
+            fix(lists[i].items[j]);
+    }
+    spilled.insert(spilled.end(), b.spilled.begin(), b.spilled.end());
+    for (std::size_t i = spill_offset; i < spilled.size(); ++i)
+        fix(spilled[i]);
+    bytes.insert(bytes.end(), b.bytes.begin(), b.bytes.end());
+    return first;
+}
+
+/// Storage for all option records of a parser.
+/// Records are carved out of chunks that double in size, so they never move
+/// and registering N options makes O(log N) allocations. The arena is freed
+/// as a whole once the parser and every option handle pointing into it are gone.
+struct opt_arena
+{
+    using opt_impl = opt_base::opt_impl;
+
+    static constexpr std::size_t first_chunk = 16;
+    static constexpr std::size_t max_chunks = 32;
+
+    ref_count ref {1};
+    std::size_t size {0};
+    opt_impl* chunks[max_chunks] {};
+    std::vector<file_buffer> files; ///< Response files that option values point into.
+    list_store lists;               ///< Values of list params.
+
+    opt_arena() {}
+    opt_arena(const opt_arena&) = delete;
+    opt_arena& operator=(const opt_arena&) = delete;
+
+    ~opt_arena()
+    {
+        std::size_t left = size;
+        for (std::size_t i = 0; i < max_chunks && chunks[i] != nullptr; ++i) {
+            std::size_t n = std::min(left, first_chunk << i);
+            for (std::size_t j = 0; j < n; ++j)
+                chunks[i][j].~opt_impl();
+            left -= n;
+            ::operator delete(chunks[i]);
+        }
+        for (auto& f : files)
+            free_file(f);
+    }
+
+    opt_impl* alloc()
+    {
+        // Chunk k holds first_chunk << k records, find where record number `size` goes.
+        std::size_t chunk = 0, offset = size;
+        while (offset >= first_chunk << chunk) {
+            offset -= first_chunk << chunk;
+            ++chunk;
+        }
+        if (chunk >= max_chunks)
+            throw std::length_error("too many options");
+        if (chunks[chunk] == nullptr)
+            chunks[chunk] = static_cast<opt_impl*>(::operator new(sizeof(opt_impl) * (first_chunk << chunk)));
+        opt_impl* o = new (&chunks[chunk][offset]) opt_impl;
+        o->pool = this;
+        o->id = static_cast<std::uint32_t>(size);
+        ++size;
+        return o;
+    }
 };
 
+static void retain(opt_arena* a) noexcept
+{
+    if (a != nullptr)
+        ++a->ref;
+}
+
+static void release(opt_arena* a) noexcept
+{
+    if (a != nullptr && --a->ref == 0)
+        delete a;
+}
+
+arena_ref::arena_ref(const arena_ref& b)
+    : _ptr{b._ptr}
+{
+    retain(_ptr);
+}
+
+arena_ref& arena_ref::operator=(const arena_ref& b)
+{
+    retain(b._ptr);
+    release(_ptr);
+    _ptr = b._ptr;
+    return *this;
+}
+
+arena_ref::arena_ref(arena_ref&& b) noexcept
+    : _ptr{b._ptr}
+{
+    b._ptr = nullptr;
+}
+
+arena_ref& arena_ref::operator=(arena_ref&& b) noexcept
+{
+    if (this != &b) {
+        release(_ptr);
+        _ptr = b._ptr;
+        b._ptr = nullptr;
+    }
+    return *this;
+}
+
+arena_ref::~arena_ref()
+{
+    release(_ptr);
+    _ptr = nullptr;
+}
+
 opt_base::opt_base(const opt_base& b)
     : _ptr{b._ptr}
 {
     if (_ptr != nullptr)
-        ++_ptr->ref;
+        retain(_ptr->pool);
 }
 
 opt_base& opt_base::operator=(const opt_base& b)
 {
-    if (_ptr != nullptr && --_ptr->ref == 0)
-        delete _ptr;
-    _ptr = b._ptr;
+    if (b._ptr != nullptr)
+        retain(b._ptr->pool);
     if (_ptr != nullptr)
-        ++_ptr->ref;
+        release(_ptr->pool);
+    _ptr = b._ptr;
     return *this;
 }
 
@@ -56,30 +524,31 @@ opt_base::opt_base(opt_base&& b) noexcept
 
 opt_base& opt_base::operator=(opt_base&& b) noexcept
 {
-    if (_ptr != nullptr && --_ptr->ref == 0)
-        delete _ptr;
-    _ptr = b._ptr;
-    b._ptr = nullptr;
+    if (this != &b) {
+        if (_ptr != nullptr)
+            release(_ptr->pool);
+        _ptr = b._ptr;
+        b._ptr = nullptr;
+    }
     return *this;
 }
 
 opt_base::~opt_base()
 {
     if (_ptr != nullptr) {
-        if (--_ptr->ref == 0)
-            delete _ptr;
+        release(_ptr->pool);
         _ptr = nullptr;
     }
 }
 
 char opt_base::shortname() const noexcept
 {
-    return _ptr != nullptr ? _ptr->shortname : 0;
+    return _ptr != nullptr ? _ptr->spec.shortname : 0;
 }
 
 const char* opt_base::longname() const noexcept
 {
-    return _ptr != nullptr && _ptr->longname != nullptr ? _ptr->longname : nullptr;
+    return _ptr != nullptr && _ptr->spec.longname != nullptr ? _ptr->spec.longname : nullptr;
 }
 
 const char* opt_base::description() const noexcept
@@ -87,203 +556,2497 @@ const char* opt_base::description() const noexcept
     return _ptr != nullptr && _ptr->desc != nullptr ? _ptr->desc : nullptr;
 }
 
+const char* opt_base::metavar() const noexcept
+{
+    if (_ptr == nullptr || (_ptr->spec.type != opt_type::param && _ptr->spec.type != opt_type::list))
+        return nullptr;
+    if (_ptr->metavar != nullptr)
+        return _ptr->metavar;
+    switch (_ptr->spec.kind) {
+    case value_kind::integer: return "INT";
+    case value_kind::real: return "FLOAT";
+    case value_kind::duration: return "DURATION";
+    case value_kind::bytes: return "SIZE";
+    default: return "VALUE";
+    }
+}
+
 bool opt_base::is_set() const noexcept
 {
-    return _ptr != nullptr && _ptr->value != nullptr;
+    return _ptr != nullptr && _ptr->slot.count != 0;
+}
+
+std::size_t opt_base::count() const noexcept
+{
+    return _ptr != nullptr ? _ptr->slot.count : 0;
+}
+
+position opt_base::position() const noexcept
+{
+    return _ptr != nullptr ? _ptr->slot.pos : argparse::position();
+}
+
+std::uint32_t opt_base::id() const noexcept
+{
+    return _ptr != nullptr ? _ptr->id : 0;
 }
 
 const char* param_t::value(const char* fallback) const noexcept
 {
-    return _ptr == nullptr || _ptr->value == nullptr ? fallback : _ptr->value;
+    return _ptr == nullptr || _ptr->slot.value == nullptr ? fallback : _ptr->slot.value;
 }
 
-} // namespace detail
+std::int64_t int_param_t::value(std::int64_t fallback) const noexcept
+{
+    return _ptr == nullptr || _ptr->slot.value == nullptr ? fallback : _ptr->slot.num.i;
+}
 
-std::string error::str() const
+double float_param_t::value(double fallback) const noexcept
 {
-    switch (_type) {
-    case ok:
-        return "ok";
-    case unknown_option: {
-        std::stringstream s;
-        s << "unknown option '" << optname() << "'";
-        return s.str();
-    }
-    case missing_argument: {
-        std::stringstream s;
-        s << "option '" << optname() << "' requires an argument";
-        return s.str();
-    }
+    return _ptr == nullptr || _ptr->slot.value == nullptr ? fallback : _ptr->slot.num.f;
+}
+
+std::chrono::nanoseconds duration_param_t::value(std::chrono::nanoseconds fallback) const noexcept
+{
+    return _ptr == nullptr || _ptr->slot.value == nullptr ? fallback : std::chrono::nanoseconds{_ptr->slot.num.i};
+}
+
+std::uint64_t bytes_param_t::value(std::uint64_t fallback) const noexcept
+{
+    return _ptr == nullptr || _ptr->slot.value == nullptr ? fallback : _ptr->slot.num.u;
+}
+
+list_view list_param_t::values() const noexcept
+{
+    if (_ptr == nullptr || _ptr->slot.value == nullptr)
+        return list_view();
+    return list_view(&_ptr->pool->lists, _ptr->slot.num.u);
+}
+
+/// FNV-1a hash of the long name.
+static std::uint32_t hash_name(const char* name, std::size_t len) noexcept
+{
+    std::uint32_t h = 2166136261u;
+    for (std::size_t i = 0; i < len; ++i)
+        h = (h ^ static_cast<unsigned char>(name[i])) * 16777619u;
+    return h;
+}
+
+/// Character histogram of the long name: 16 buckets by the low 4 bits of
+/// a character, each a count that saturates at 15.
+static std::uint64_t name_hist(const char* name, std::size_t len) noexcept
+{
+    std::uint64_t h = 0;
+    for (std::size_t i = 0; i < len; ++i) {
+        const unsigned shift = (static_cast<unsigned char>(name[i]) & 15) * 4;
+        if (((h >> shift) & 15) != 15)
+            h += std::uint64_t(1) << shift;
     }
-    assert(0 && "unexpected error type");
+    return h;
 }
 
-void parser::_remove_duplicates(const names_t& names)
+/// Finds the registered long name closest to an unknown one, for "did you
+/// mean" hints. Candidates are fed one by one to consider(), the first one
+/// with the smallest edit distance wins.
+///
+/// Edit distance is computed with the bit-parallel algorithm of Myers, as
+/// formulated by Hyyrö, with the unknown name as the pattern: one pass of a
+/// few word operations per character of a candidate. Before that, candidates
+/// that can't beat the best distance so far are dropped by their length and
+/// histogram, since every edit changes the length by at most 1 and the
+/// histogram by at most 2. Unknown names longer than 64 characters get no
+/// suggestions.
+struct suggester
 {
-    if (names.shortname != 0) {
-        for (auto it = _opts.begin(); it != _opts.end(); ++it) {
-            if (it->_ptr == nullptr)
-                continue;
-            if (it->_ptr->type == detail::opt_type::category)
-                continue;
-            if (it->_ptr->shortname == names.shortname) {
-                if (it->_ptr->longname == nullptr) {
-                    _opts.erase(it);
-                } else {
-                    it->_ptr->shortname = 0;
-                }
-                break;
-            }
+    suggester(const char* name, std::size_t len) noexcept
+        : _len{len}, _hist{name_hist(name, len)}
+    {
+        if (len == 0 || len > 64)
+            return;
+        std::memset(_peq, 0, sizeof(_peq));
+        for (std::size_t i = 0; i < len; ++i)
+            _peq[static_cast<unsigned char>(name[i])] |= std::uint64_t(1) << i;
+        // Allow about one edit per three characters, but no more than 3.
+        _best_dist = std::min<std::size_t>(3, (len + 2) / 3) + 1;
+    }
+
+    void consider(const opt_spec& o) noexcept
+    {
+        if (o.longname == nullptr || _best_dist == 0)
+            return;
+        const std::size_t dlen = o.longlen > _len ? o.longlen - _len : _len - o.longlen;
+        if (dlen >= _best_dist || (hist_diff(_hist, o.hist) + 1) / 2 >= _best_dist)
+            return;
+        const std::size_t d = distance(o.longname, o.longlen);
+        if (d < _best_dist) {
+            best = o.longname;
+            _best_dist = d;
         }
     }
 
-    if (names.longname != nullptr) {
-        for (auto it = _opts.begin(); it != _opts.end(); ++it) {
-            if (it->_ptr == nullptr || it->_ptr->longname == nullptr)
-                continue;
-            if (it->_ptr->type == detail::opt_type::category)
-                continue;
-            if (std::strcmp(it->_ptr->longname, names.longname) == 0) {
-                if (it->_ptr->shortname == 0) {
-                    _opts.erase(it);
-                } else {
-                    it->_ptr->longname = nullptr;
-                }
-                break;
-            }
+    const char* best {nullptr};
+
+private:
+    static std::size_t hist_diff(std::uint64_t a, std::uint64_t b) noexcept
+    {
+        std::size_t sum = 0;
+        for (unsigned shift = 0; shift < 64; shift += 4) {
+            const unsigned x = (a >> shift) & 15, y = (b >> shift) & 15;
+            sum += x > y ? x - y : y - x;
         }
+        return sum;
     }
-}
 
-parser::flag_t parser::flag(names_t names, const char* desc)
-{
-    assert(names.shortname != 0 || names.longname != nullptr);
-    if (names.shortname != 0) {
-        assert((names.shortname >= '0' && names.shortname <= '9')
-            || (names.shortname >= 'a' && names.shortname <= 'z')
-            || (names.shortname >= 'A' && names.shortname <= 'Z'));
+    /// Edit distance to s, or anything not below _best_dist if it's not closer.
+    std::size_t distance(const char* s, std::size_t n) const noexcept
+    {
+        const std::uint64_t high = std::uint64_t(1) << (_len - 1);
+        std::uint64_t vp = ~std::uint64_t(0), vn = 0;
+        std::size_t score = _len;
+        for (std::size_t j = 0; j < n; ++j) {
+            const std::uint64_t eq = _peq[static_cast<unsigned char>(s[j])];
+            const std::uint64_t xv = eq | vn;
+            const std::uint64_t xh = (((eq & vp) + vp) ^ vp) | eq;
+            std::uint64_t ph = vn | ~(xh | vp);
+            std::uint64_t mh = vp & xh;
+            if (ph & high)
+                ++score;
+            else if (mh & high)
+                --score;
+            // The score drops by at most 1 per remaining character.
+            if (score >= _best_dist + (n - j - 1))
+                return _best_dist;
+            ph = (ph << 1) | 1;
+            mh <<= 1;
+            vp = mh | ~(xv | ph);
+            vn = ph & xv;
+        }
+        return score;
     }
-    _remove_duplicates(names);
 
-    flag_t o;
-    o._ptr = new detail::opt_base::opt_impl;
-    o._ptr->type = detail::opt_type::flag;
-    o._ptr->shortname = names.shortname;
-    o._ptr->longname = names.longname;
-    o._ptr->desc = desc;
-    _opts.push_back(o);
-    return o;
+    std::size_t _len;
+    std::uint64_t _hist;
+    std::size_t _best_dist {0}; ///< Distance to beat, 0 if suggestions are disabled.
+    std::uint64_t _peq[256]; ///< Bit i of _peq[c] is set if name[i] == c.
+};
+
+static constexpr std::size_t npos_slot = static_cast<std::size_t>(-1);
+
+/// Inserts an entry into a long name index with linear probing.
+/// The index has to have a free slot.
+static void index_insert(std::vector<index_entry>& index, index_entry e) noexcept
+{
+    const std::size_t mask = index.size() - 1;
+    std::size_t slot = e.hash & mask;
+    while (index[slot].pos != 0)
+        slot = (slot + 1) & mask;
+    index[slot] = e;
 }
 
-parser::param_t parser::param(names_t names, const char* desc)
+/// Finds the slot of a long name in the index, npos_slot if it's not there.
+/// spec_at(pos) returns the option spec that entry position pos refers to.
+template <typename SpecAt>
+static std::size_t index_find(const std::vector<index_entry>& index,
+        const char* name, std::size_t len, std::uint32_t hash, SpecAt spec_at) noexcept
 {
-    assert(names.shortname != 0 || names.longname != nullptr);
-    if (names.shortname != 0) {
-        assert((names.shortname >= '0' && names.shortname <= '9')
-            || (names.shortname >= 'a' && names.shortname <= 'z')
-            || (names.shortname >= 'A' && names.shortname <= 'Z'));
+    if (index.empty())
+        return npos_slot;
+    const std::size_t mask = index.size() - 1;
+    for (std::size_t slot = hash & mask; index[slot].pos != 0; slot = (slot + 1) & mask) {
+        const auto& e = index[slot];
+        if (e.hash != hash)
+            continue;
+        const opt_spec& o = spec_at(e.pos);
+        if (o.longlen == len && std::memcmp(o.longname, name, len) == 0)
+            return slot;
     }
-    _remove_duplicates(names);
-
-    param_t o;
-    o._ptr = new detail::opt_base::opt_impl;
-    o._ptr->type = detail::opt_type::param;
-    o._ptr->shortname = names.shortname;
-    o._ptr->longname = names.longname;
-    o._ptr->desc = desc;
-    _opts.push_back(o);
-    return o;
+    return npos_slot;
 }
 
-void parser::category(const char* name)
+/// Appends argv[begin] ... argv[end - 1] to positional arguments, that are
+/// stored as runs of consecutive argv indexes. Runs of the current argument
+/// list start at runs[first].
+static void append_args(std::vector<arg_run>& runs, std::size_t first, std::size_t& nargs, int begin, int end)
 {
-    assert(name != nullptr);
-    opt_base o;
-    o._ptr = new detail::opt_base::opt_impl;
-    o._ptr->type = detail::opt_type::category;
-    o._ptr->desc = name;
-    _opts.push_back(o);
+    if (runs.size() == first || runs.back().begin + (nargs - runs.back().offset) != static_cast<std::size_t>(begin))
+        runs.push_back(arg_run{static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(nargs)});
+    nargs += end - begin;
 }
 
-error parser::parse(int argc, const char* const* argv)
+/// Parses unsigned decimal digits at p. Returns the end of the digits, which
+/// is p if there are none, or nullptr on overflow.
+static const char* scan_uint(const char* p, std::uint64_t& out) noexcept
 {
-    if (_progname != nullptr)
-        throw std::runtime_error("arguments already parsed");
-    if (argc < 1)
-        throw std::runtime_error("invalid argc value");
-    if (argv == nullptr)
-        throw std::runtime_error("invalid argv value");
-
-    _progname = argv[0];
+    std::uint64_t v = 0;
+    for (; *p >= '0' && *p <= '9'; ++p) {
+        unsigned d = static_cast<unsigned>(*p - '0');
+        if (v > (UINT64_MAX - d) / 10)
+            return nullptr;
+        v = v * 10 + d;
+    }
+    out = v;
+    return p;
+}
 
-    auto lookup_short = [this](char c) -> opt_base {
-        for (auto it = _opts.begin(); it != _opts.end(); ++it)
-            if (it->_ptr->shortname != 0 && it->_ptr->shortname == c)
-                return *it;
-        return {};
+/// Parses an unsigned decimal floating point number at p, like "1.5e3".
+/// Returns the end of the number, or nullptr if there is no valid number.
+static const char* scan_real(const char* p, double& out) noexcept
+{
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
     };
 
-    auto lookup_long = [this](const char* n) -> opt_base {
-        for (auto it = _opts.begin(); it != _opts.end(); ++it)
-            if (it->_ptr->longname != nullptr && std::strcmp(it->_ptr->longname, n) == 0)
-                return *it;
-        return {};
+    std::uint64_t mant = 0;
+    int ndigits = 0; // Significant digits in mant.
+    int exp10 = 0;
+    bool any = false, exact = true;
+    auto digit = [&](unsigned d, bool fraction) {
+        any = true;
+        if (ndigits < 19) {
+            mant = mant * 10 + d;
+            if (mant != 0)
+                ++ndigits;
+            if (fraction)
+                --exp10;
+        } else {
+            if (!fraction)
+                ++exp10;
+            if (d != 0)
+                exact = false;
+        }
     };
 
-    int i = 1;
+    for (; *p >= '0' && *p <= '9'; ++p)
+        digit(static_cast<unsigned>(*p - '0'), false);
+    if (*p == '.')
+        for (++p; *p >= '0' && *p <= '9'; ++p)
+            digit(static_cast<unsigned>(*p - '0'), true);
+    if (!any)
+        return nullptr;
 
-    for (; i < argc; ++i) {
-        const char* arg = argv[i];
-        if (arg == nullptr)
-            throw std::runtime_error("invalid arg value");
-        if (arg[0] != '-') {
-            _args.push_back(arg);
-        } else {
-            if (arg[1] == '\0') {
-                // single dash "-"
-                _args.push_back(arg);
-            } else if (arg[1] == '-') {
-                if (arg[2] == '\0') {
-                    // double dash "--"
-                    ++i;
-                    break;
-                } else {
-                    auto it = lookup_long(&arg[2]);
-                    if (it._ptr == nullptr) {
-                        return error(error::unknown_option, arg);
-                    } else if (it._ptr->type == detail::opt_type::flag) {
-                        it._ptr->value = reinterpret_cast<const char*>(1);
-                    } else if (it._ptr->type == detail::opt_type::param) {
-                        if (++i >= argc)
-                            return error(error::missing_argument, arg);
-                        it._ptr->value = argv[i];
-                    } else {
-                        assert(0 && "unexpected option type");
-                    }
-                }
-            } else {
-                for (const char* c = &arg[1]; *c != '\0'; ++c) {
-                    auto it = lookup_short(*c);
-                    if (it._ptr == nullptr) {
-                        return error(error::unknown_option, *c);
-                    } else if (it._ptr->type == detail::opt_type::flag) {
-                        it._ptr->value = reinterpret_cast<const char*>(1);
-                    } else if (it._ptr->type == detail::opt_type::param) {
-                        if (*(c + 1) != '\0' || ++i >= argc)
-                            return error(error::missing_argument, *c);
-                        it._ptr->value = argv[i];
-                    } else {
-                        assert(0 && "unexpected option type");
-                    }
-                }
-            }
+    if (*p == 'e' || *p == 'E') {
+        const char* q = p + 1;
+        bool neg = *q == '-';
+        if (*q == '-' || *q == '+')
+            ++q;
+        if (*q >= '0' && *q <= '9') {
+            int e = 0;
+            for (; *q >= '0' && *q <= '9'; ++q)
+                if (e < 10000)
+                    e = e * 10 + (*q - '0');
+            exp10 += neg ? -e : e;
+            p = q;
         }
     }
 
-    for (; i < argc; ++i)
-        _args.push_back(argv[i]);
+    // Both the mantissa and the power of ten are exact doubles, so a single
+    // multiplication or division rounds correctly.
+    if (exact && mant <= (std::uint64_t{1} << 53) && exp10 >= -22 && exp10 <= 22) {
+        double m = static_cast<double>(mant);
+        out = exp10 < 0 ? m / pow10[-exp10] : m * pow10[exp10];
+        return p;
+    }
+    if (mant == 0) {
+        out = 0;
+        return p;
+    }
+    // Anything else is rare. Scaling in long double keeps enough extra bits
+    // that the result is off by at most an ulp, without going through the
+    // locale or allocating like the standard conversions do.
+    long double scale = 1, base = 10;
+    for (unsigned e = static_cast<unsigned>(exp10 < 0 ? -exp10 : exp10); e != 0; e >>= 1, base *= base)
+        if (e & 1)
+            scale *= base;
+    long double m = static_cast<long double>(mant);
+    out = static_cast<double>(exp10 < 0 ? m / scale : m * scale);
+    if (out == HUGE_VAL)
+        return nullptr;
+    return p;
+}
 
-    return error();
+static bool parse_int(const char* s, std::int64_t& out) noexcept
+{
+    bool neg = *s == '-';
+    if (neg)
+        ++s;
+    std::uint64_t u;
+    const char* end = scan_uint(s, u);
+    if (end == nullptr || end == s || *end != '\0')
+        return false;
+    const std::uint64_t limit = static_cast<std::uint64_t>(INT64_MAX) + (neg ? 1 : 0);
+    if (u > limit)
+        return false;
+    out = neg ? static_cast<std::int64_t>(0 - u) : static_cast<std::int64_t>(u);
+    return true;
+}
+
+static bool parse_real(const char* s, double& out) noexcept
+{
+    bool neg = *s == '-';
+    if (neg)
+        ++s;
+    double d;
+    const char* end = scan_real(s, d);
+    if (end == nullptr || *end != '\0')
+        return false;
+    out = neg ? -d : d;
+    return true;
+}
+
+static bool parse_duration(const char* s, std::int64_t& out) noexcept
+{
+    struct unit_t { const char* name; std::size_t len; std::uint64_t ns; };
+    // Two letter units go first, so "ms" isn't taken for "m".
+    static const unit_t units[] = {
+        {"ns", 2, 1}, {"us", 2, 1000}, {"ms", 2, 1000000},
+        {"s", 1, 1000000000}, {"m", 1, 60000000000}, {"h", 1, 3600000000000},
+    };
+
+    bool neg = *s == '-';
+    if (neg)
+        ++s;
+    const std::uint64_t limit = static_cast<std::uint64_t>(INT64_MAX) + (neg ? 1 : 0);
+    const char* p = s;
+    // Whole numbers are added up exactly, only fractions and exponents have
+    // to go through doubles.
+    std::uint64_t total = 0;
+    double frac = 0;
+    do {
+        std::uint64_t whole;
+        const char* end = scan_uint(p, whole);
+        if (end == nullptr)
+            return false;
+        double d = 0;
+        bool real = end == p || *end == '.' || *end == 'e' || *end == 'E';
+        if (real && (end = scan_real(p, d)) == nullptr)
+            return false;
+        const unit_t* unit = nullptr;
+        for (const auto& u : units) {
+            if (std::strncmp(end, u.name, u.len) == 0) {
+                unit = &u;
+                break;
+            }
+        }
+        if (unit == nullptr) {
+            // Plain number of seconds, only on its own.
+            if (p != s || *end != '\0')
+                return false;
+            unit = &units[3];
+            p = end;
+        } else {
+            p = end + unit->len;
+        }
+        if (real) {
+            frac += d * static_cast<double>(unit->ns);
+        } else {
+            if (whole > (limit - total) / unit->ns)
+                return false;
+            total += whole * unit->ns;
+        }
+    } while (*p != '\0');
+
+    frac += 0.5;
+    if (!(frac < static_cast<double>(limit - total) + 1))
+        return false;
+    std::uint64_t ns = total + static_cast<std::uint64_t>(frac);
+    if (ns > limit)
+        return false;
+    out = neg ? static_cast<std::int64_t>(0 - ns) : static_cast<std::int64_t>(ns);
+    return true;
+}
+
+static bool parse_bytes(const char* s, std::uint64_t& out) noexcept
+{
+    std::uint64_t whole;
+    const char* p = scan_uint(s, whole);
+    if (p == nullptr)
+        return false;
+    bool any = p != s;
+    double frac = 0;
+    bool has_frac = *p == '.';
+    if (has_frac) {
+        double scale = 0.1;
+        for (++p; *p >= '0' && *p <= '9'; ++p, scale *= 0.1) {
+            frac += (*p - '0') * scale;
+            any = true;
+        }
+    }
+    if (!any)
+        return false;
+
+    unsigned shift = 0;
+    switch (*p) {
+    case 'k': case 'K': shift = 10; break;
+    case 'M': shift = 20; break;
+    case 'G': shift = 30; break;
+    case 'T': shift = 40; break;
+    case 'P': shift = 50; break;
+    case 'E': shift = 60; break;
+    }
+    if (shift != 0) {
+        ++p;
+        if (*p == 'i' && p[1] == 'B')
+            p += 2;
+        else if (*p == 'B')
+            ++p;
+    } else if (*p == 'B') {
+        ++p;
+    }
+    // Fractions of a byte don't make sense.
+    if (*p != '\0' || (has_frac && shift == 0))
+        return false;
+
+    if (whole > (UINT64_MAX >> shift))
+        return false;
+    std::uint64_t v = whole << shift;
+    std::uint64_t f = static_cast<std::uint64_t>(frac * static_cast<double>(std::uint64_t{1} << shift));
+    if (v > UINT64_MAX - f)
+        return false;
+    out = v + f;
+    return true;
+}
+
+/// Converts the value of a typed param. Returns false if it's not valid.
+static bool convert_value(value_kind kind, const char* value, opt_number& num)
+{
+    switch (kind) {
+    case value_kind::string:
+        return true;
+    case value_kind::integer:
+        return parse_int(value, num.i);
+    case value_kind::real:
+        return parse_real(value, num.f);
+    case value_kind::duration:
+        return parse_duration(value, num.i);
+    case value_kind::bytes:
+        return parse_bytes(value, num.u);
+    }
+    return false;
+}
+
+/// Option found by a lookup, and where its parse results go.
+struct opt_match
+{
+    const opt_spec* spec;
+    opt_slot* slot;
+    std::uint32_t id;
+};
+
+/// Stores the value of a param or list param.
+/// Returns false if the value of a typed param is not valid.
+template <typename Target>
+static bool set_value(Target& t, const opt_match& it, const char* value)
+{
+    if (it.spec->type == opt_type::list) {
+        list_store& lists = t.lists();
+        if (it.slot->count == 0)
+            it.slot->num.u = lists.create();
+        lists.add(it.slot->num.u, value, it.spec->delimiter);
+    } else if (it.spec->kind != value_kind::string && !convert_value(it.spec->kind, value, it.slot->num)) {
+        return false;
+    }
+    it.slot->value = value;
+    ++it.slot->count;
+    return true;
+}
+
+/// Arguments of an argv array, after the program name.
+struct argv_source
+{
+    int argc;
+    const char* const* argv;
+    int i;
+
+    const char* next()
+    {
+        if (i >= argc)
+            return nullptr;
+        if (argv[i] == nullptr)
+            throw std::runtime_error("invalid arg value");
+        return argv[i++];
+    }
+
+    /// Skips the remaining arguments without looking at them.
+    /// Returns how many there were.
+    int rest()
+    {
+        const int n = argc - i;
+        i = argc;
+        return n;
+    }
+};
+
+/// Arguments of a NUL separated buffer, walked in place.
+/// Every argument, starting with the program name, is appended to args, so
+/// argument numbers index into it like into argv.
+struct buffer_source
+{
+    const char* p;
+    const char* end;
+    std::vector<const char*>& args;
+
+    const char* next()
+    {
+        if (p == end)
+            return nullptr;
+        const char* arg = p;
+        auto nul = static_cast<const char*>(std::memchr(p, '\0', end - p));
+        if (nul == nullptr)
+            throw std::runtime_error("unterminated argument");
+        p = nul + 1;
+        args.push_back(arg);
+        return arg;
+    }
+
+    /// Walks the remaining arguments. Returns how many there were.
+    int rest()
+    {
+        int n = 0;
+        while (next() != nullptr)
+            ++n;
+        return n;
+    }
+};
+
+/// Parses arguments into a target. Shared by all parser front-ends, the
+/// target only decides where options are looked up and where results are stored:
+///   opt_match lookup_short(char c);
+///   opt_match lookup_long(const char* name, std::size_t len);
+///   const char* suggest(const char* name, std::size_t len); // closest long name
+///   opt_match lookup_abbreviation(const char* name, std::size_t len,
+///           const char*& candidates, std::size_t& count); // with allow_abbreviations
+///   bool add_args(int begin, int end); // arguments [begin, end), false if there is no room left
+///   void record(std::uint32_t id, position pos); // occurrence of an option
+///   void add_error(const error& e); // with collect_errors
+/// The source yields arguments after the program name, nullptr at the end,
+/// and skips all remaining arguments at once, returning how many there were:
+///   const char* next();
+///   int rest();
+/// Argument indexes count from 1, like in argv.
+/// Returns the first error. With collect_errors, the offending option or
+/// argument is skipped and parsing goes on, every error goes to the target.
+template <typename Target, typename Source>
+static error parse_args(Target& t, Source& src, unsigned flags)
+{
+    int i = 0;
+    const char* arg;
+    error first;
+
+    // Returns true if parsing has to stop.
+    auto fail = [&](const error& e) {
+        if (first.type() == error::ok)
+            first = e;
+        if (!(flags & collect_errors))
+            return true;
+        t.add_error(e);
+        return false;
+    };
+    // Occurrences are recorded once they are accepted, so rejected ones
+    // collected with collect_errors don't count as present.
+    auto accept = [&t](const opt_match& it, position pos) {
+        it.slot->pos = pos;
+        t.record(it.id, pos);
+    };
+
+    while ((arg = src.next()) != nullptr) {
+        ++i;
+        if (arg[0] != '-' || arg[1] == '\0') {
+            // argument or single dash "-"
+            if (flags & stop_at_first_arg)
+                break;
+            if (!t.add_args(i, i + 1) && fail(error(error::too_many_arguments, arg)))
+                return first;
+        } else if (arg[1] == '-') {
+            if (arg[2] == '\0') {
+                // double dash "--"
+                arg = src.next();
+                ++i;
+                break;
+            } else {
+                // "--name=value", the value points right past the '='.
+                const char* name = &arg[2];
+                const std::size_t len = std::strcspn(name, "=");
+                const char* inline_value = name[len] == '=' ? &name[len + 1] : nullptr;
+
+                auto it = t.lookup_long(name, len);
+                // An empty name, as in "--=x", would be a prefix of every option.
+                if (it.spec == nullptr && (flags & allow_abbreviations) && len != 0) {
+                    const char* candidates = nullptr;
+                    std::size_t count = 0;
+                    it = t.lookup_abbreviation(name, len, candidates, count);
+                    if (count > 1) {
+                        if (fail(error(error::ambiguous_option, arg, candidates, count)))
+                            return first;
+                        continue;
+                    }
+                }
+                if (it.spec == nullptr) {
+                    if (fail(error(error::unknown_option, arg, t.suggest(name, len))))
+                        return first;
+                    continue;
+                }
+                const position pos(static_cast<std::uint32_t>(i), 0);
+                if (it.spec->type == opt_type::flag) {
+                    if (inline_value != nullptr) {
+                        if (fail(error(error::unexpected_argument, arg)))
+                            return first;
+                        continue;
+                    }
+                    ++it.slot->count;
+                } else if (it.spec->type == opt_type::param || it.spec->type == opt_type::list) {
+                    const char* value = inline_value;
+                    if (value == nullptr) {
+                        value = src.next();
+                        if (value == nullptr) {
+                            fail(error(error::missing_argument, arg));
+                            return first;
+                        }
+                        ++i;
+                    }
+                    if (!set_value(t, it, value)) {
+                        if (fail(error(error::invalid_value, arg)))
+                            return first;
+                        continue;
+                    }
+                } else {
+                    assert(0 && "unexpected option type");
+                }
+                accept(it, pos);
+            }
+        } else {
+            for (const char* c = &arg[1]; *c != '\0'; ++c) {
+                auto it = t.lookup_short(*c);
+                if (it.spec == nullptr) {
+                    if (fail(error(error::unknown_option, *c)))
+                        return first;
+                    continue;
+                }
+                const position pos(static_cast<std::uint32_t>(i), static_cast<std::uint32_t>(c - arg));
+                if (it.spec->type == opt_type::flag) {
+                    ++it.slot->count;
+                } else if (it.spec->type == opt_type::param || it.spec->type == opt_type::list) {
+                    const char* value = *(c + 1) == '\0' ? src.next() : nullptr;
+                    if (value == nullptr) {
+                        if (fail(error(error::missing_argument, *c)))
+                            return first;
+                        continue;
+                    }
+                    ++i;
+                    if (!set_value(t, it, value)) {
+                        if (fail(error(error::invalid_value, *c)))
+                            return first;
+                        continue;
+                    }
+                } else {
+                    assert(0 && "unexpected option type");
+                }
+                accept(it, pos);
+            }
+        }
+    }
+
+    // Everything after "--", or after the first argument with
+    // stop_at_first_arg, is an argument. Added as a single run, so with argv
+    // this doesn't depend on how many arguments are left.
+    if (arg != nullptr && !t.add_args(i, i + 1 + src.rest()) && fail(error(error::too_many_arguments, arg)))
+        return first;
+
+    return first;
+}
+
+/// Appends names of an option for the help page, eg. "-o, --output FILE".
+/// Options without a short name are indented, so long names line up.
+static void help_names(std::string& out, const opt_spec& spec, const char* metavar)
+{
+    if (spec.shortname != 0) {
+        out += '-';
+        out += spec.shortname;
+        if (spec.longname != nullptr)
+            out += ", ";
+    } else {
+        out.append(4, ' ');
+    }
+    if (spec.longname != nullptr) {
+        out += "--";
+        out.append(spec.longname, spec.longlen);
+    }
+    if (metavar != nullptr) {
+        out += ' ';
+        out += metavar;
+    }
+}
+
+/// Appends text wrapped at word boundaries to lines of width columns,
+/// starting at column col of the current line. Continuation lines are
+/// indented to col. Words that don't fit on a line by themselves are not
+/// broken. Ends with a newline.
+static void help_wrap(std::string& out, const char* text, std::size_t col, std::size_t width)
+{
+    const std::size_t avail = width > col ? width - col : 0;
+    std::size_t line = 0;
+    for (const char* p = text; *p != '\0';) {
+        if (*p == '\n') {
+            out += '\n';
+            out.append(col, ' ');
+            line = 0;
+            ++p;
+            continue;
+        }
+        if (*p == ' ') {
+            ++p;
+            continue;
+        }
+        const std::size_t len = std::strcspn(p, " \n");
+        if (line != 0 && line + 1 + len > avail) {
+            out += '\n';
+            out.append(col, ' ');
+            line = 0;
+        } else if (line != 0) {
+            out += ' ';
+            ++line;
+        }
+        out.append(p, len);
+        line += len;
+        p += len;
+    }
+    out += '\n';
+}
+
+/// Writes everything to a file descriptor, with a single write call unless
+/// it's partial. Returns false on failure.
+static bool write_all(int fd, const char* p, std::size_t size)
+{
+#ifdef ARGPARSE_POSIX
+    // Pipes and terminals can take less than everything, finish the rest.
+    while (size != 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        p += n;
+        size -= static_cast<std::size_t>(n);
+    }
+    return true;
+#else
+    std::FILE* f = fd == 2 ? stderr : stdout;
+    return std::fwrite(p, 1, size, f) == size && std::fflush(f) == 0;
+#endif
+}
+
+void name_trie::clear() noexcept
+{
+    buf.clear();
+    entries.clear();
+    nodes.clear();
+}
+
+void name_trie::add(const char* prefix, const char* name, std::size_t len, std::uint32_t id, kind_t kind)
+{
+    entry e;
+    e.offset = static_cast<std::uint32_t>(buf.size());
+    buf += prefix;
+    buf.append(name, len);
+    e.len = static_cast<std::uint32_t>(buf.size() - e.offset);
+    buf += '\0';
+    e.id = id;
+    e.kind = kind;
+    entries.push_back(e);
+}
+
+void name_trie::build()
+{
+    std::sort(entries.begin(), entries.end(), [this](const entry& a, const entry& b) {
+        return std::strcmp(name(a), name(b)) < 0;
+    });
+    // Store the names in the same order, so names of a range are a run.
+    std::string sorted;
+    sorted.reserve(buf.size());
+    for (auto& e : entries) {
+        const std::size_t offset = sorted.size();
+        sorted.append(name(e), e.len + 1);
+        e.offset = static_cast<std::uint32_t>(offset);
+    }
+    buf.swap(sorted);
+
+    // Breadth first, so children of every node end up next to each other.
+    // There is at most a node per character.
+    nodes.reserve(buf.size() + 1);
+    nodes.assign(1, node{0, 0, static_cast<std::uint32_t>(entries.size()), 0, 0});
+    std::vector<std::uint32_t> depth(1, 0);
+    depth.reserve(buf.size() + 1);
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+        const std::uint32_t d = depth[n];
+        std::uint32_t i = nodes[n].begin;
+        const std::uint32_t end = nodes[n].end;
+        // Names that end at this node sort first.
+        while (i < end && entries[i].len == d)
+            ++i;
+        nodes[n].child = static_cast<std::uint32_t>(nodes.size());
+        while (i < end) {
+            const char c = buf[entries[i].offset + d];
+            std::uint32_t j = i + 1;
+            while (j < end && buf[entries[j].offset + d] == c)
+                ++j;
+            nodes.push_back(node{0, i, j, 0, c});
+            depth.push_back(d + 1);
+            i = j;
+        }
+        nodes[n].nchild = static_cast<std::uint16_t>(nodes.size() - nodes[n].child);
+    }
+}
+
+void name_trie::find(const char* prefix, std::size_t len, std::size_t& begin, std::size_t& end) const noexcept
+{
+    begin = end = 0;
+    const node* n = nodes.empty() ? nullptr : walk(&nodes[0], prefix, len);
+    if (n != nullptr) {
+        begin = n->begin;
+        end = n->end;
+    }
+}
+
+auto name_trie::walk(const node* n, const char* s, std::size_t len) const noexcept -> const node*
+{
+    for (std::size_t d = 0; n != nullptr && d < len; ++d) {
+        // Children are sorted by their character, like the names.
+        const auto c = static_cast<unsigned char>(s[d]);
+        const node* first = nodes.data() + n->child;
+        const node* last = first + n->nchild;
+        const node* it = std::lower_bound(first, last, c, [](const node& a, unsigned char c) {
+            return static_cast<unsigned char>(a.c) < c;
+        });
+        n = it != last && static_cast<unsigned char>(it->c) == c ? it : nullptr;
+    }
+    return n;
+}
+
+/// Finds long options that name is an abbreviation of. Returns the entry of
+/// the option if there is exactly one. If there are more, sets candidates to
+/// their names and count to their number.
+static const name_trie::entry* find_abbreviation(const name_trie& trie,
+        const char* name, std::size_t len, const char*& candidates, std::size_t& count) noexcept
+{
+    const name_trie::node* n = trie.empty() ? nullptr : trie.walk(&trie.nodes[0], "--", 2);
+    n = trie.walk(n, name, len);
+    if (n == nullptr)
+        return nullptr;
+    // Short options and commands never start with two dashes.
+    if (n->end - n->begin == 1)
+        return &trie.entries[n->begin];
+    candidates = trie.name(trie.entries[n->begin]);
+    count = n->end - n->begin;
+    return nullptr;
+}
+
+static unsigned ctz64(std::uint64_t x) noexcept
+{
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(x));
+#else
+    unsigned n = 0;
+    for (; (x & 1) == 0; x >>= 1)
+        ++n;
+    return n;
+#endif
+}
+
+void constraint_set::add(kind_t kind, std::uint32_t subject, const std::vector<std::uint32_t>& opts)
+{
+    rule r;
+    r.kind = kind;
+    r.subject = subject;
+    r.begin = static_cast<std::uint32_t>(ids.size());
+    ids.insert(ids.end(), opts.begin(), opts.end());
+    r.end = static_cast<std::uint32_t>(ids.size());
+    r.names = 0;
+    r.mask_begin = 0;
+    r.mask_end = 0;
+    rules.push_back(r);
+}
+
+void constraint_set::build(const std::vector<opt_spec>& specs)
+{
+    _words = (specs.size() + 63) / 64;
+    masks.clear();
+    name_at.assign(specs.size(), UINT32_MAX);
+    names.clear();
+
+    auto add_name = [&](std::uint32_t id) {
+        const auto offset = static_cast<std::uint32_t>(names.size());
+        const auto& spec = specs[id];
+        // Constraints can't refer to categories, so this option was shadowed
+        // and could never be present.
+        if (spec.type == opt_type::category)
+            throw std::logic_error("constraint on a shadowed option");
+        if (spec.longname != nullptr) {
+            names += "--";
+            names.append(spec.longname, spec.longlen);
+        } else if (spec.shortname != 0) {
+            names += '-';
+            names += spec.shortname;
+        }
+        names += '\0';
+        if (name_at[id] == UINT32_MAX)
+            name_at[id] = offset;
+    };
+
+    std::vector<std::uint32_t> sorted;
+    for (auto& rule : rules) {
+        // Names of the options of a rule are a run, for exactly_one errors.
+        rule.names = static_cast<std::uint32_t>(names.size());
+        for (std::uint32_t i = rule.begin; i < rule.end; ++i)
+            add_name(ids[i]);
+        if (rule.kind == depends)
+            add_name(rule.subject);
+
+        sorted.assign(ids.begin() + rule.begin, ids.begin() + rule.end);
+        std::sort(sorted.begin(), sorted.end());
+        rule.mask_begin = static_cast<std::uint32_t>(masks.size());
+        for (auto id : sorted) {
+            if (masks.size() == rule.mask_begin || masks.back().word != id / 64)
+                masks.push_back(mask{id / 64, 0});
+            masks.back().bits |= std::uint64_t(1) << (id % 64);
+        }
+        rule.mask_end = static_cast<std::uint32_t>(masks.size());
+    }
+}
+
+error constraint_set::check(const std::uint64_t* present, error_list* errors) const
+{
+    error first;
+    // Returns true if checking has to stop.
+    auto fail = [&](const error& e) {
+        if (first.type() == error::ok)
+            first = e;
+        if (errors == nullptr)
+            return true;
+        errors->add(e);
+        return false;
+    };
+    auto name = [this](std::uint32_t id) { return names.data() + name_at[id]; };
+
+    for (const auto& rule : rules) {
+        const mask* begin = masks.data() + rule.mask_begin;
+        const mask* end = masks.data() + rule.mask_end;
+        switch (rule.kind) {
+        case depends:
+            if (!(present[rule.subject / 64] >> (rule.subject % 64) & 1))
+                break;
+            // fall through
+        case required:
+            for (const mask* m = begin; m != end; ++m) {
+                for (std::uint64_t missing = m->bits & ~present[m->word]; missing != 0; missing &= missing - 1) {
+                    const auto id = static_cast<std::uint32_t>(m->word * 64 + ctz64(missing));
+                    if (fail(rule.kind == required
+                            ? error(error::missing_option, name(id))
+                            : error(error::missing_option, name(id), name(rule.subject))))
+                        return first;
+                }
+            }
+            break;
+        case exclusive:
+        case exactly_one: {
+            // Any option present, and more than one, without counting them.
+            std::uint64_t any = 0, many = 0;
+            for (const mask* m = begin; m != end; ++m) {
+                const std::uint64_t set = m->bits & present[m->word];
+                many |= (set & (set - 1)) | (any != 0 ? set : 0);
+                any |= set;
+            }
+            if (any == 0 && rule.kind == exactly_one) {
+                if (fail(error(error::missing_option, names.data() + rule.names,
+                        names.data() + rule.names, rule.end - rule.begin)))
+                    return first;
+            } else if (many != 0) {
+                // Report the first two, in the order of option ids.
+                std::uint32_t found[2];
+                std::size_t n = 0;
+                for (const mask* m = begin; m != end && n < 2; ++m)
+                    for (std::uint64_t set = m->bits & present[m->word]; set != 0 && n < 2; set &= set - 1)
+                        found[n++] = static_cast<std::uint32_t>(m->word * 64 + ctz64(set));
+                if (fail(error(error::conflicting_options, name(found[0]), name(found[1]))))
+                    return first;
+            }
+            break;
+        }
+        }
+    }
+    return first;
+}
+
+/// Checks constraints after parsing. Options that were present are taken
+/// from the first of occurrences, touched or slots that is set.
+static error check_constraints(const constraint_set& c, error res, error_list* errors, unsigned flags,
+        const std::vector<occurrence>* occurrences, const std::vector<std::uint32_t>* touched, const opt_slot* slots)
+{
+    if (c.empty() || (!res && !(flags & collect_errors)))
+        return res;
+    std::uint64_t small[4] = {};
+    std::vector<std::uint64_t> large;
+    std::uint64_t* present = small;
+    if (c.words() > 4) {
+        large.assign(c.words(), 0);
+        present = large.data();
+    }
+    auto set = [present](std::uint32_t id) { present[id / 64] |= std::uint64_t(1) << (id % 64); };
+    if (occurrences != nullptr) {
+        for (const auto& o : *occurrences)
+            set(o.id);
+    } else if (touched != nullptr) {
+        for (auto id : *touched)
+            set(id);
+    } else {
+        for (std::uint32_t id = 0; id < c.name_at.size(); ++id)
+            if (slots[id].count != 0)
+                set(id);
+    }
+    error e = c.check(present, flags & collect_errors ? errors : nullptr);
+    return res ? e : res;
+}
+
+} // namespace detail
+
+std::string error::str() const
+{
+    char buf[128];
+    std::size_t len = format(buf, sizeof(buf));
+    if (len < sizeof(buf))
+        return std::string(buf, len);
+    std::string s(len + 1, '\0');
+    format(&s[0], s.size());
+    s.resize(len);
+    return s;
+}
+
+std::size_t error::format(char* buf, std::size_t size) const noexcept
+{
+    const char* prefix = nullptr;
+    const char* suffix = "";   // After optname(), which is left out if this is empty.
+    const char* tail = "";     // After candidates and the other option.
+    switch (_type) {
+    case ok:
+        prefix = "ok";
+        break;
+    case unknown_option:
+        prefix = "unknown option '";
+        suffix = _other != nullptr ? "', did you mean '--" : "'";
+        tail = _other != nullptr ? "'?" : "";
+        break;
+    case missing_argument:
+        prefix = "option '";
+        suffix = "' requires an argument";
+        break;
+    case too_many_arguments:
+        prefix = "too many arguments";
+        break;
+    case unexpected_argument:
+        prefix = "option '";
+        suffix = "' doesn't allow an argument";
+        break;
+    case invalid_value:
+        prefix = "invalid value for option '";
+        suffix = "'";
+        break;
+    case unknown_command:
+        prefix = "unknown command '";
+        suffix = _other != nullptr ? "', did you mean '" : "'";
+        tail = _other != nullptr ? "'?" : "";
+        break;
+    case ambiguous_option:
+        prefix = "option '";
+        suffix = "' is ambiguous; possibilities:";
+        break;
+    case missing_option:
+        if (_ncandidates != 0) {
+            prefix = "one of";
+            tail = " is required";
+        } else {
+            prefix = "option '";
+            suffix = _other != nullptr ? "' is required by '" : "' is required";
+            tail = _other != nullptr ? "'" : "";
+        }
+        break;
+    case conflicting_options:
+        prefix = "options '";
+        suffix = "' and '";
+        tail = "' can't be used together";
+        break;
+    }
+    assert(prefix != nullptr && "unexpected error type");
+    if (prefix == nullptr)
+        prefix = "";
+
+    std::size_t len = 0;
+    auto put = [&](const char* s, std::size_t n) {
+        if (len + 1 < size)
+            std::memcpy(buf + len, s, std::min(n, size - 1 - len));
+        len += n;
+    };
+    put(prefix, std::strlen(prefix));
+    if (*suffix != '\0') {
+        // Long options given with "=value" are printed without the value.
+        put(optname(), _type == unknown_command ? std::strlen(optname()) : std::strcspn(optname(), "="));
+        put(suffix, std::strlen(suffix));
+    }
+    const char* c = _candidates;
+    for (std::uint32_t i = 0; i < _ncandidates; ++i) {
+        const std::size_t n = std::strlen(c);
+        put(" '", 2);
+        put(c, n);
+        put("'", 1);
+        c += n + 1;
+    }
+    if (_other != nullptr)
+        put(_other, std::strlen(_other));
+    put(tail, std::strlen(tail));
+    if (size != 0)
+        buf[std::min(len, size - 1)] = '\0';
+    return len;
+}
+
+void parser::_remove_duplicates(const names_t& names)
+{
+    if (names.shortname != 0) {
+        auto*& prev = _short_index[static_cast<unsigned char>(names.shortname)];
+        if (prev != nullptr) {
+            if (prev->spec.longname == nullptr) {
+                prev->shadowed = true;
+                ++_shadowed;
+            } else {
+                prev->spec.shortname = 0;
+            }
+            prev = nullptr;
+        }
+    }
+
+    if (names.longname != nullptr) {
+        std::size_t len = std::strlen(names.longname);
+        std::size_t slot = _find_long_slot(names.longname, len, detail::hash_name(names.longname, len));
+        if (slot != detail::npos_slot) {
+            auto* prev = _opts[_long_index[slot].pos - 1]._ptr;
+            if (prev->spec.shortname == 0) {
+                prev->shadowed = true;
+                ++_shadowed;
+            } else {
+                prev->spec.longname = nullptr;
+                prev->spec.longlen = 0;
+            }
+            _erase_long_slot(slot);
+        }
+    }
+
+    // Shadowed options are dropped from the list in bulk. Compacting only once
+    // they make up half of it keeps registration amortized O(1).
+    if (_shadowed * 2 > _opts.size())
+        _compact();
+}
+
+detail::opt_base::opt_impl* parser::_alloc()
+{
+    if (_arena._ptr == nullptr)
+        _arena._ptr = new detail::opt_arena;
+    auto* o = _arena._ptr->alloc();
+    // The returned record is owned by a handle, which keeps the arena alive.
+    detail::retain(_arena._ptr);
+    return o;
+}
+
+void parser::_add(detail::opt_base& o, names_t names, const char* desc,
+        detail::opt_type type, detail::value_kind kind)
+{
+    assert(names.shortname != 0 || names.longname != nullptr);
+    if (names.shortname != 0) {
+        assert((names.shortname >= '0' && names.shortname <= '9')
+            || (names.shortname >= 'a' && names.shortname <= 'z')
+            || (names.shortname >= 'A' && names.shortname <= 'Z'));
+    }
+    _remove_duplicates(names);
+
+    o._ptr = _alloc();
+    o._ptr->spec.type = type;
+    o._ptr->spec.shortname = names.shortname;
+    o._ptr->spec.longname = names.longname;
+    o._ptr->spec.longlen = names.longname != nullptr ? std::strlen(names.longname) : 0;
+    o._ptr->spec.hist = detail::name_hist(names.longname, o._ptr->spec.longlen);
+    o._ptr->spec.kind = kind;
+    o._ptr->desc = desc;
+    _opts.push_back(o);
+    _help.clear();
+    _trie.clear();
+    if (names.shortname != 0)
+        _short_index[static_cast<unsigned char>(names.shortname)] = o._ptr;
+    if (names.longname != nullptr)
+        _insert_long(o._ptr, _opts.size());
+}
+
+parser::flag_t parser::flag(names_t names, const char* desc)
+{
+    flag_t o;
+    _add(o, names, desc, detail::opt_type::flag, detail::value_kind::string);
+    return o;
+}
+
+parser::counter_t parser::counter(names_t names, const char* desc)
+{
+    counter_t o;
+    _add(o, names, desc, detail::opt_type::flag, detail::value_kind::string);
+    return o;
+}
+
+parser::param_t parser::param(names_t names, const char* desc, const char* metavar)
+{
+    param_t o;
+    _add(o, names, desc, detail::opt_type::param, detail::value_kind::string);
+    o._ptr->metavar = metavar;
+    return o;
+}
+
+parser::int_param_t parser::int_param(names_t names, const char* desc, const char* metavar)
+{
+    int_param_t o;
+    _add(o, names, desc, detail::opt_type::param, detail::value_kind::integer);
+    o._ptr->metavar = metavar;
+    return o;
+}
+
+parser::float_param_t parser::float_param(names_t names, const char* desc, const char* metavar)
+{
+    float_param_t o;
+    _add(o, names, desc, detail::opt_type::param, detail::value_kind::real);
+    o._ptr->metavar = metavar;
+    return o;
+}
+
+parser::duration_param_t parser::duration_param(names_t names, const char* desc, const char* metavar)
+{
+    duration_param_t o;
+    _add(o, names, desc, detail::opt_type::param, detail::value_kind::duration);
+    o._ptr->metavar = metavar;
+    return o;
+}
+
+parser::bytes_param_t parser::bytes_param(names_t names, const char* desc, const char* metavar)
+{
+    bytes_param_t o;
+    _add(o, names, desc, detail::opt_type::param, detail::value_kind::bytes);
+    o._ptr->metavar = metavar;
+    return o;
+}
+
+parser::list_param_t parser::list_param(names_t names, const char* desc, char delimiter, const char* metavar)
+{
+    list_param_t o;
+    _add(o, names, desc, detail::opt_type::list, detail::value_kind::string);
+    o._ptr->spec.delimiter = delimiter;
+    o._ptr->metavar = metavar;
+    return o;
+}
+
+void parser::category(const char* name)
+{
+    assert(name != nullptr);
+    opt_base o;
+    o._ptr = _alloc();
+    o._ptr->spec.type = detail::opt_type::category;
+    o._ptr->desc = name;
+    _opts.push_back(o);
+    _help.clear();
+    _trie.clear();
+}
+
+void parser::required(const opt_base& o)
+{
+    _constrain(detail::constraint_set::required, nullptr, {o});
+}
+
+void parser::exclusive(std::initializer_list<opt_base> opts)
+{
+    _constrain(detail::constraint_set::exclusive, nullptr, opts);
+}
+
+void parser::exactly_one(std::initializer_list<opt_base> opts)
+{
+    _constrain(detail::constraint_set::exactly_one, nullptr, opts);
+}
+
+void parser::depends(const opt_base& o, std::initializer_list<opt_base> opts)
+{
+    _constrain(detail::constraint_set::depends, &o, opts);
+}
+
+void parser::_constrain(detail::constraint_set::kind_t kind, const opt_base* subject,
+        std::initializer_list<opt_base> opts)
+{
+    auto id = [this](const opt_base& o) {
+        assert(o._ptr != nullptr && o._ptr->pool == _arena._ptr && "option of another parser");
+        assert(o._ptr->spec.type != detail::opt_type::category);
+        return o._ptr->id;
+    };
+    std::vector<std::uint32_t> ids;
+    ids.reserve(opts.size());
+    for (const auto& o : opts)
+        ids.push_back(id(o));
+    _constraints.add(kind, subject != nullptr ? id(*subject) : 0, ids);
+}
+
+void parser::command(const char* name, std::function<void(parser&)> factory, const char* desc)
+{
+    assert(name != nullptr && *name != '\0' && *name != '-');
+    assert(factory);
+    const std::size_t len = std::strlen(name);
+    detail::command c;
+    c.spec = detail::opt_spec{detail::opt_type::category, 0, name, len,
+            detail::value_kind::string, 0, detail::name_hist(name, len)};
+    c.desc = desc;
+    c.factory = std::move(factory);
+    _help.clear();
+    _trie.clear();
+
+    const std::uint32_t hash = detail::hash_name(name, len);
+    std::size_t slot = detail::index_find(_command_index, name, len, hash,
+            [this](std::uint32_t pos) -> const detail::opt_spec& { return _commands[pos - 1].spec; });
+    if (slot != detail::npos_slot) {
+        // Later commands replace earlier ones with the same name.
+        _commands[_command_index[slot].pos - 1] = std::move(c);
+        return;
+    }
+
+    _commands.push_back(std::move(c));
+    // Keep the load factor at or below 1/2, so probe sequences stay short.
+    if (_commands.size() * 2 > _command_index.size()) {
+        _command_index.assign(std::max<std::size_t>(8, _command_index.size() * 2), detail::index_entry{});
+        for (std::size_t i = 0; i < _commands.size(); ++i) {
+            const auto& spec = _commands[i].spec;
+            detail::index_entry e;
+            e.hash = detail::hash_name(spec.longname, spec.longlen);
+            e.pos = static_cast<std::uint32_t>(i + 1);
+            detail::index_insert(_command_index, e);
+        }
+    } else {
+        detail::index_entry e;
+        e.hash = hash;
+        e.pos = static_cast<std::uint32_t>(_commands.size());
+        detail::index_insert(_command_index, e);
+    }
+}
+
+const char* parser::command_name() const
+{
+    return _selected != 0 ? _commands[_selected - 1].spec.longname : nullptr;
+}
+
+const parser* parser::subparser() const
+{
+    return _selected != 0 ? _commands[_selected - 1].sub.get() : nullptr;
+}
+
+const std::string& parser::help(std::size_t width) const
+{
+    if (!_help.empty() && _help_width == width)
+        return _help;
+
+    // Names longer than this get their description on the next line,
+    // instead of pushing every description to the right.
+    const std::size_t max_names = 30;
+    const std::size_t indent = 2, gap = 2;
+
+    const auto& opts = this->opts();
+    std::string names;
+    std::size_t names_width = 0, total = 0;
+    for (const auto& o : opts) {
+        const auto& spec = o._ptr->spec;
+        if (spec.type == detail::opt_type::category)
+            continue;
+        names.clear();
+        detail::help_names(names, spec, o.metavar());
+        if (names.size() <= max_names)
+            names_width = std::max(names_width, names.size());
+        total += indent + names.size() + gap + 1;
+        if (o._ptr->desc != nullptr)
+            total += std::strlen(o._ptr->desc) * 2;
+    }
+    for (const auto& c : _commands) {
+        if (c.spec.longlen <= max_names)
+            names_width = std::max(names_width, c.spec.longlen);
+        total += indent + c.spec.longlen + gap + 1;
+        if (c.desc != nullptr)
+            total += std::strlen(c.desc) * 2;
+    }
+    const std::size_t col = indent + names_width + gap;
+
+    // Puts the description of the entry that starts at start, after its names.
+    auto describe = [&](std::size_t start, const char* desc) {
+        if (desc == nullptr || *desc == '\0') {
+            _help += '\n';
+            return;
+        }
+        const std::size_t len = _help.size() - start;
+        if (len + gap > col) {
+            _help += '\n';
+            _help.append(col, ' ');
+        } else {
+            _help.append(col - len, ' ');
+        }
+        detail::help_wrap(_help, desc, col, width);
+    };
+
+    _help.clear();
+    _help.reserve(total);
+    std::size_t pending = 0; // Category waiting for its first option, + 1.
+    for (std::size_t i = 0; i < opts.size(); ++i) {
+        const auto& o = opts[i];
+        const auto& spec = o._ptr->spec;
+        if (spec.type == detail::opt_type::category) {
+            pending = i + 1;
+            continue;
+        }
+        if (pending != 0) {
+            if (!_help.empty())
+                _help += '\n';
+            _help += opts[pending - 1]._ptr->desc;
+            _help += ":\n";
+            pending = 0;
+        }
+
+        const std::size_t start = _help.size();
+        _help.append(indent, ' ');
+        detail::help_names(_help, spec, o.metavar());
+        describe(start, o._ptr->desc);
+    }
+
+    if (!_commands.empty()) {
+        if (!_help.empty())
+            _help += '\n';
+        _help += "Commands:\n";
+        for (const auto& c : _commands) {
+            const std::size_t start = _help.size();
+            _help.append(indent, ' ');
+            _help.append(c.spec.longname, c.spec.longlen);
+            describe(start, c.desc);
+        }
+    }
+
+    _help_width = width;
+    return _help;
+}
+
+bool parser::print_help(int fd, std::size_t width) const
+{
+    const std::string& page = help(width);
+    return detail::write_all(fd, page.data(), page.size());
+}
+
+const detail::name_trie& parser::_names() const
+{
+    if (!_trie.empty())
+        return _trie;
+    const auto& opts = this->opts();
+    for (std::size_t i = 0; i < opts.size(); ++i) {
+        const auto& spec = opts[i]._ptr->spec;
+        const auto id = static_cast<std::uint32_t>(i);
+        if (spec.longname != nullptr)
+            _trie.add("--", spec.longname, spec.longlen, id, detail::name_trie::long_opt);
+        if (spec.shortname != 0)
+            _trie.add("-", &spec.shortname, 1, id, detail::name_trie::short_opt);
+    }
+    for (std::size_t i = 0; i < _commands.size(); ++i) {
+        const auto& spec = _commands[i].spec;
+        _trie.add("", spec.longname, spec.longlen, static_cast<std::uint32_t>(i), detail::name_trie::command);
+    }
+    _trie.build();
+    return _trie;
+}
+
+std::size_t parser::complete(int argc, const char* const* argv, std::vector<const char*>& out)
+{
+    if (argc < 1)
+        throw std::runtime_error("invalid argc value");
+    if (argv == nullptr)
+        throw std::runtime_error("invalid argv value");
+
+    // Skip over everything before the word under the cursor, to find out
+    // what it can be: an option, a value of an option, or a command.
+    bool value = false, dashes = false;
+    for (int i = 1; i < argc - 1; ++i) {
+        const char* arg = argv[i];
+        if (value) {
+            value = false;
+        } else if (dashes || arg[0] != '-' || arg[1] == '\0') {
+            if (dashes || _commands.empty())
+                continue;
+            const std::size_t len = std::strlen(arg);
+            std::size_t slot = detail::index_find(_command_index, arg, len, detail::hash_name(arg, len),
+                    [this](std::uint32_t pos) -> const detail::opt_spec& { return _commands[pos - 1].spec; });
+            if (slot == detail::npos_slot)
+                return 0;
+            auto& c = _commands[_command_index[slot].pos - 1];
+            if (c.sub == nullptr) {
+                c.sub = std::make_shared<parser>();
+                c.factory(*c.sub);
+            }
+            return c.sub->complete(argc - i, argv + i, out);
+        } else if (arg[1] == '-') {
+            if (arg[2] == '\0') {
+                dashes = true;
+                continue;
+            }
+            const std::size_t len = std::strcspn(&arg[2], "=");
+            auto* o = _find_long(&arg[2], len);
+            value = o != nullptr && o->spec.type != detail::opt_type::flag && arg[2 + len] != '=';
+        } else {
+            for (const char* c = &arg[1]; *c != '\0'; ++c) {
+                auto* o = _short_index[static_cast<unsigned char>(*c)];
+                if (o != nullptr && o->spec.type != detail::opt_type::flag) {
+                    value = c[1] == '\0';
+                    break;
+                }
+            }
+        }
+    }
+
+    const char* word = argc > 1 ? argv[argc - 1] : "";
+    if (value || dashes || std::strchr(word, '=') != nullptr)
+        return 0;
+    // Commands are only before the first positional argument, which
+    // would have been followed into its command already.
+    const bool option = word[0] == '-';
+    if (!option && _commands.empty())
+        return 0;
+
+    const auto& trie = _names();
+    std::size_t begin, end, n = 0;
+    trie.find(word, std::strlen(word), begin, end);
+    for (std::size_t i = begin; i < end; ++i) {
+        const auto& e = trie.entries[i];
+        if (option || e.kind == detail::name_trie::command) {
+            out.push_back(trie.name(e));
+            ++n;
+        }
+    }
+    return n;
+}
+
+bool parser::handle_completion(int argc, const char* const* argv, int fd)
+{
+    if (argc < 2 || argv == nullptr || std::strcmp(argv[1], "__complete") != 0)
+        return false;
+    // "__complete" takes the place of the program name.
+    std::vector<const char*> words;
+    complete(argc - 1, argv + 1, words);
+    std::string lines;
+    for (const char* w : words) {
+        lines += w;
+        lines += '\n';
+    }
+    detail::write_all(fd, lines.data(), lines.size());
+    return true;
+}
+
+std::string parser::completion_script(shell sh, const char* progname)
+{
+    assert(progname != nullptr && *progname != '\0');
+    // Shell function names can't have every character a program name can.
+    std::string fn = "_argparse_complete_";
+    for (const char* p = progname; *p != '\0'; ++p) {
+        const char c = *p;
+        fn += (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ? c : '_';
+    }
+
+    std::string s;
+    switch (sh) {
+    case shell::bash:
+        s += fn + "() {\n"
+            "    local IFS=$'\\n'\n"
+            "    COMPREPLY=($(\"${COMP_WORDS[0]}\" __complete \"${COMP_WORDS[@]:1:COMP_CWORD}\" 2>/dev/null))\n"
+            "}\n"
+            "complete -o default -F " + fn + " " + progname + "\n";
+        break;
+    case shell::zsh:
+        s += "#compdef " + std::string(progname) + "\n" + fn + "() {\n"
+            "    local -a candidates\n"
+            "    candidates=(${(f)\"$(\"${words[1]}\" __complete \"${(@)words[2,CURRENT]}\" 2>/dev/null)\"})\n"
+            "    if (( ${#candidates} )); then\n"
+            "        compadd -Q -- \"${candidates[@]}\"\n"
+            "    else\n"
+            "        _files\n"
+            "    fi\n"
+            "}\n"
+            "compdef " + fn + " " + progname + "\n";
+        break;
+    case shell::fish:
+        s += "function " + fn + "\n"
+            "    set -l tokens (commandline -opc)\n"
+            "    set -l prog $tokens[1]\n"
+            "    set -e tokens[1]\n"
+            "    set -l word (commandline -ct)\n"
+            "    $prog __complete $tokens \"$word\" 2>/dev/null\n"
+            "end\n"
+            "complete -c " + std::string(progname) + " -a '(" + fn + ")'\n";
+        break;
+    }
+    return s;
+}
+
+void parser::_compact() const
+{
+    if (_shadowed != 0) {
+        _opts.erase(std::remove_if(_opts.begin(), _opts.end(),
+                [](const opt_base& o) { return o._ptr->shadowed; }), _opts.end());
+        _shadowed = 0;
+    }
+
+    // Positions in the list have moved, reinsert everything.
+    _long_index.assign(_long_index.size(), detail::index_entry{});
+    _long_count = 0;
+    for (std::size_t i = 0; i < _opts.size(); ++i)
+        if (_opts[i]._ptr->spec.longname != nullptr)
+            _insert_long(_opts[i]._ptr, i + 1);
+}
+
+void parser::_insert_long(detail::opt_base::opt_impl* o, std::size_t pos) const
+{
+    // Keep the load factor at or below 1/2, so probe sequences stay short.
+    if ((_long_count + 1) * 2 > _long_index.size()) {
+        std::vector<detail::index_entry> prev(_long_index.size() < 8 ? 16 : _long_index.size() * 2);
+        prev.swap(_long_index);
+        for (const auto& e : prev)
+            if (e.pos != 0)
+                detail::index_insert(_long_index, e);
+    }
+
+    detail::index_entry e;
+    e.hash = detail::hash_name(o->spec.longname, o->spec.longlen);
+    e.pos = static_cast<std::uint32_t>(pos);
+    detail::index_insert(_long_index, e);
+    ++_long_count;
+}
+
+void parser::_erase_long_slot(std::size_t slot)
+{
+    // Backward shift deletion: pull later entries of the probe sequence into
+    // the hole, so lookups never have to skip over tombstones.
+    const std::size_t mask = _long_index.size() - 1;
+    std::size_t hole = slot;
+    for (std::size_t i = (slot + 1) & mask; _long_index[i].pos != 0; i = (i + 1) & mask) {
+        std::size_t home = _long_index[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            _long_index[hole] = _long_index[i];
+            hole = i;
+        }
+    }
+    _long_index[hole] = detail::index_entry{};
+    --_long_count;
+}
+
+std::size_t parser::_find_long_slot(const char* name, std::size_t len, std::uint32_t hash) const noexcept
+{
+    return detail::index_find(_long_index, name, len, hash,
+            [this](std::uint32_t pos) -> const detail::opt_spec& { return _opts[pos - 1]._ptr->spec; });
+}
+
+detail::opt_base::opt_impl* parser::_find_long(const char* name, std::size_t len) const noexcept
+{
+    std::size_t slot = _find_long_slot(name, len, detail::hash_name(name, len));
+    return slot != detail::npos_slot ? _opts[_long_index[slot].pos - 1]._ptr : nullptr;
+}
+
+error parser::parse(int argc, const char* const* argv, unsigned flags)
+{
+    if (_progname != nullptr)
+        throw std::runtime_error("arguments already parsed");
+    if (argc < 1)
+        throw std::runtime_error("invalid argc value");
+    if (argv == nullptr)
+        throw std::runtime_error("invalid argv value");
+
+    _progname = argv[0];
+    if (_shadowed != 0)
+        _compact();
+
+    if (flags & expand_response_files) {
+        // Option values can point into the files, the arena keeps them
+        // alive for as long as the option handles.
+        if (_arena._ptr == nullptr)
+            _arena._ptr = new detail::opt_arena;
+        detail::expand_response_files(argc, argv, _expanded, _arena._ptr->files);
+        argc = static_cast<int>(_expanded.size()) - 1;
+        argv = _expanded.data();
+    }
+
+    _argv = argv;
+    detail::argv_source src {argc, argv, 1};
+    if (_commands.empty())
+        return _parse(src, flags);
+    return _dispatch(_parse(src, flags | stop_at_first_arg), flags);
+}
+
+error parser::parse(const char* buf, std::size_t len, unsigned flags)
+{
+    if (_progname != nullptr)
+        throw std::runtime_error("arguments already parsed");
+    if (buf == nullptr && len != 0)
+        throw std::runtime_error("invalid buf value");
+
+    _expanded.clear();
+    detail::buffer_source src {buf, buf + len, _expanded};
+    const char* progname = src.next();
+    if (progname == nullptr)
+        throw std::runtime_error("invalid len value");
+    _progname = progname;
+    if (_shadowed != 0)
+        _compact();
+
+    error res = _parse(src, _commands.empty() ? flags : flags | stop_at_first_arg);
+    _expanded.push_back(nullptr);
+    _argv = _expanded.data();
+    return _commands.empty() ? res : _dispatch(res, flags);
+}
+
+error parser::_dispatch(error res, unsigned flags)
+{
+    if (_nargs == 0 || (!res && !(flags & collect_errors)))
+        return res;
+
+    // Parsing stopped at the command, the remaining arguments start with it.
+    const char* const* argv = _argv + _runs[0].begin;
+    const char* name = argv[0];
+    const std::size_t len = std::strlen(name);
+    std::size_t slot = detail::index_find(_command_index, name, len, detail::hash_name(name, len),
+            [this](std::uint32_t pos) -> const detail::opt_spec& { return _commands[pos - 1].spec; });
+    if (slot == detail::npos_slot) {
+        detail::suggester sg(name, len);
+        for (const auto& c : _commands)
+            sg.consider(c.spec);
+        error e(error::unknown_command, name, sg.best);
+        if (flags & collect_errors)
+            _errors.add(e);
+        return res ? e : res;
+    }
+
+    _selected = _command_index[slot].pos;
+    auto& c = _commands[_selected - 1];
+    c.sub = std::make_shared<parser>();
+    c.factory(*c.sub);
+    // Response files were already expanded.
+    error sub = c.sub->parse(static_cast<int>(_nargs), argv, flags & ~expand_response_files);
+    if (flags & collect_errors)
+        _errors.add(c.sub->errors());
+    return res ? sub : res;
+}
+
+template <typename Source>
+error parser::_parse(Source& src, unsigned flags)
+{
+    // Lookups return borrowed records, the option list keeps them alive.
+    struct target
+    {
+        parser& p;
+
+        static detail::opt_match match(detail::opt_base::opt_impl* o)
+        {
+            return o != nullptr ? detail::opt_match{&o->spec, &o->slot, o->id} : detail::opt_match{};
+        }
+
+        detail::opt_match lookup_short(char c)
+        {
+            return match(p._short_index[static_cast<unsigned char>(c)]);
+        }
+
+        detail::opt_match lookup_long(const char* name, std::size_t len)
+        {
+            return match(p._find_long(name, len));
+        }
+
+        detail::opt_match lookup_abbreviation(const char* name, std::size_t len,
+                const char*& candidates, std::size_t& count)
+        {
+            // Names come from the compacted option list, ids are positions in it.
+            const auto* e = detail::find_abbreviation(p._names(), name, len, candidates, count);
+            return e != nullptr ? match(p._opts[e->id]._ptr) : detail::opt_match{};
+        }
+
+        const char* suggest(const char* name, std::size_t len)
+        {
+            detail::suggester sg(name, len);
+            for (const auto& o : p._opts)
+                if (!o._ptr->shadowed)
+                    sg.consider(o._ptr->spec);
+            return sg.best;
+        }
+
+        detail::list_store& lists()
+        {
+            // List params are registered options, so the arena exists.
+            return p._arena._ptr->lists;
+        }
+
+        void record(std::uint32_t id, position pos)
+        {
+            p._occurrences.push_back(occurrence{id, pos});
+        }
+
+        void add_error(const error& e) { p._errors.add(e); }
+
+        bool add_args(int begin, int end)
+        {
+            detail::append_args(p._runs, 0, p._nargs, begin, end);
+            return true;
+        }
+    };
+
+    target t {*this};
+    error res = detail::parse_args(t, src, flags);
+    if (_constraints.empty())
+        return res;
+    _constraints.build(_specs());
+    return detail::check_constraints(_constraints, res, &_errors, flags, &_occurrences, nullptr, nullptr);
+}
+
+namespace detail {
+
+error static_parse(const static_view& view, opt_slot* slots,
+        arg_run* runs, std::size_t max_runs, std::size_t& nruns, std::size_t& nargs,
+        error_list& errors, int argc, const char* const* argv, unsigned flags)
+{
+    if (argc < 1)
+        throw std::runtime_error("invalid argc value");
+    if (argv == nullptr)
+        throw std::runtime_error("invalid argv value");
+
+    struct target
+    {
+        const static_view& view;
+        opt_slot* slots;
+        arg_run* runs;
+        std::size_t max_runs;
+        std::size_t& nruns;
+        std::size_t& nargs;
+        error_list& errors;
+
+        opt_match lookup_short(char c)
+        {
+            auto i = static_cast<unsigned char>(c);
+            std::uint16_t pos = i < 128 ? view.short_index[i] : 0;
+            return pos != 0 ? opt_match{&view.opts[pos - 1], &slots[pos - 1], std::uint32_t(pos - 1)} : opt_match{};
+        }
+
+        opt_match lookup_long(const char* name, std::size_t len)
+        {
+            // Static option sets are small, a scan over the precomputed hashes
+            // is enough. Going backwards lets later options shadow earlier ones.
+            const std::uint32_t hash = hash_name(name, len);
+            for (std::size_t i = view.size; i-- > 0;) {
+                const opt_spec& o = view.opts[i];
+                if (view.hashes[i] == hash && o.longname != nullptr
+                        && o.longlen == len && std::memcmp(o.longname, name, len) == 0)
+                    return opt_match{&o, &slots[i], static_cast<std::uint32_t>(i)};
+            }
+            return opt_match{};
+        }
+
+        opt_match lookup_abbreviation(const char*, std::size_t, const char*&, std::size_t&)
+        {
+            return opt_match{};
+        }
+
+        const char* suggest(const char* name, std::size_t len)
+        {
+            suggester sg(name, len);
+            for (std::size_t i = 0; i < view.size; ++i)
+                sg.consider(view.opts[i]);
+            return sg.best;
+        }
+
+        list_store& lists()
+        {
+            throw std::logic_error("static parsers have no list params");
+        }
+
+        void record(std::uint32_t, position) {}
+
+        void add_error(const error& e) { errors.add(e); }
+
+        bool add_args(int begin, int end)
+        {
+            if (nruns == 0 || runs[nruns - 1].begin + (nargs - runs[nruns - 1].offset) != static_cast<std::size_t>(begin)) {
+                if (nruns >= max_runs)
+                    return false;
+                runs[nruns++] = arg_run{static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(nargs)};
+            }
+            nargs += end - begin;
+            return true;
+        }
+    };
+
+    nruns = 0;
+    nargs = 0;
+    errors.clear();
+    target t {view, slots, runs, max_runs, nruns, nargs, errors};
+    argv_source src {argc, argv, 1};
+    return parse_args(t, src, flags);
+}
+
+} // namespace detail
+
+struct schema::schema_impl
+{
+    detail::ref_count ref {1};
+    detail::arena_ref arena;
+    std::vector<detail::opt_spec> specs; ///< Indexed by option id.
+    std::uint32_t short_index[256] {};   ///< Option id + 1, by unsigned char.
+    std::vector<detail::index_entry> long_index;
+
+    /// Long names for abbreviations, entry ids are option ids.
+    /// Built on first use, from any thread.
+    const detail::name_trie& names() const
+    {
+        std::call_once(names_once, [this] {
+            for (std::uint32_t id = 0; id < specs.size(); ++id)
+                if (specs[id].longname != nullptr)
+                    trie.add("--", specs[id].longname, specs[id].longlen, id, detail::name_trie::long_opt);
+            trie.build();
+        });
+        return trie;
+    }
+
+    mutable detail::name_trie trie;
+    mutable std::once_flag names_once;
+
+    bool commands {false}; ///< Parser has commands, see parser::compile().
+
+    detail::constraint_set constraints; ///< Built over specs.
+
+    /// Parses argv into specs.size() slots, appends positional arguments to runs.
+    /// If touched is set, ids of options accepted for the first time are appended to it.
+    error parse(detail::opt_slot* slots, detail::list_store& lists, std::vector<occurrence>* occurrences, error_list* errors, std::vector<detail::arg_run>& runs, std::size_t& nargs,
+            std::vector<std::uint32_t>* touched, int argc, const char* const* argv, unsigned flags) const;
+
+    /// Same as above for any argument source.
+    template <typename Source>
+    error parse(detail::opt_slot* slots, detail::list_store& lists, std::vector<occurrence>* occurrences, error_list* errors, std::vector<detail::arg_run>& runs, std::size_t& nargs,
+            std::vector<std::uint32_t>* touched, Source& src, unsigned flags) const;
+};
+
+const schema::schema_impl& schema::_impl() const
+{
+    // Default constructed schema behaves like one without any options.
+    static const schema_impl empty;
+    return _ptr != nullptr ? *_ptr : empty;
+}
+
+schema::schema(const schema& b)
+    : _ptr{b._ptr}
+{
+    if (_ptr != nullptr)
+        ++_ptr->ref;
+}
+
+schema& schema::operator=(const schema& b)
+{
+    if (b._ptr != nullptr)
+        ++b._ptr->ref;
+    if (_ptr != nullptr && --_ptr->ref == 0)
+        delete _ptr;
+    _ptr = b._ptr;
+    return *this;
+}
+
+schema::schema(schema&& b) noexcept
+    : _ptr{b._ptr}
+{
+    b._ptr = nullptr;
+}
+
+schema& schema::operator=(schema&& b) noexcept
+{
+    if (this != &b) {
+        if (_ptr != nullptr && --_ptr->ref == 0)
+            delete _ptr;
+        _ptr = b._ptr;
+        b._ptr = nullptr;
+    }
+    return *this;
+}
+
+schema::~schema()
+{
+    if (_ptr != nullptr) {
+        if (--_ptr->ref == 0)
+            delete _ptr;
+        _ptr = nullptr;
+    }
+}
+
+schema parser::compile() const
+{
+    if (_shadowed != 0)
+        _compact();
+
+    schema s;
+    s._ptr = new schema::schema_impl;
+    auto& impl = *s._ptr;
+    impl.arena = _arena;
+
+    // Copy the specs, so registering or shadowing options later on can't
+    // change the schema.
+    impl.specs = _specs();
+    const std::size_t size = impl.specs.size();
+    std::size_t nlong = 0;
+    for (const auto& spec : impl.specs)
+        if (spec.longname != nullptr)
+            ++nlong;
+
+    for (std::size_t c = 0; c < 256; ++c)
+        if (_short_index[c] != nullptr)
+            impl.short_index[c] = _short_index[c]->id + 1;
+
+    std::size_t index_size = 8;
+    while (index_size < nlong * 2)
+        index_size <<= 1;
+    impl.long_index.resize(index_size);
+    for (std::uint32_t id = 0; id < size; ++id) {
+        const auto& o = impl.specs[id];
+        if (o.longname == nullptr)
+            continue;
+        detail::index_entry e;
+        e.hash = detail::hash_name(o.longname, o.longlen);
+        e.pos = id + 1;
+        detail::index_insert(impl.long_index, e);
+    }
+
+    impl.constraints = _constraints;
+    impl.constraints.build(impl.specs);
+    impl.commands = !_commands.empty();
+    return s;
+}
+
+std::vector<detail::opt_spec> parser::_specs() const
+{
+    // Categories and shadowed options keep an empty spec.
+    std::size_t size = _arena._ptr != nullptr ? _arena._ptr->size : 0;
+    std::vector<detail::opt_spec> specs(size, detail::opt_spec{detail::opt_type::category, 0, nullptr, 0, detail::value_kind::string, 0, 0});
+    for (const auto& o : _opts)
+        if (o._ptr->spec.type != detail::opt_type::category)
+            specs[o._ptr->id] = o._ptr->spec;
+    return specs;
+}
+
+template <typename Source>
+error schema::schema_impl::parse(detail::opt_slot* slots, detail::list_store& lists, std::vector<occurrence>* occurrences, error_list* errors, std::vector<detail::arg_run>& runs, std::size_t& nargs,
+        std::vector<std::uint32_t>* touched, Source& src, unsigned flags) const
+{
+    struct target
+    {
+        const schema_impl& s;
+        detail::opt_slot* slots;
+        std::vector<detail::arg_run>& runs;
+        std::size_t first;
+        std::size_t& nargs;
+        std::vector<std::uint32_t>* touched;
+        detail::list_store& store;
+        std::vector<occurrence>* occurrences;
+        error_list* errors;
+
+        detail::list_store& lists() { return store; }
+
+        void record(std::uint32_t id, position pos)
+        {
+            if (touched != nullptr && slots[id].count == 1)
+                touched->push_back(id);
+            if (occurrences != nullptr)
+                occurrences->push_back(occurrence{id, pos});
+        }
+
+        void add_error(const error& e)
+        {
+            if (errors != nullptr)
+                errors->add(e);
+        }
+
+        detail::opt_match match(std::uint32_t pos)
+        {
+            return detail::opt_match{&s.specs[pos - 1], &slots[pos - 1], pos - 1};
+        }
+
+        detail::opt_match lookup_short(char c)
+        {
+            std::uint32_t pos = s.short_index[static_cast<unsigned char>(c)];
+            return pos != 0 ? match(pos) : detail::opt_match{};
+        }
+
+        detail::opt_match lookup_long(const char* name, std::size_t len)
+        {
+            std::size_t slot = detail::index_find(s.long_index, name, len, detail::hash_name(name, len),
+                    [this](std::uint32_t pos) -> const detail::opt_spec& { return s.specs[pos - 1]; });
+            return slot != detail::npos_slot ? match(s.long_index[slot].pos) : detail::opt_match{};
+        }
+
+        detail::opt_match lookup_abbreviation(const char* name, std::size_t len,
+                const char*& candidates, std::size_t& count)
+        {
+            const auto* e = detail::find_abbreviation(s.names(), name, len, candidates, count);
+            return e != nullptr ? match(e->id + 1) : detail::opt_match{};
+        }
+
+        const char* suggest(const char* name, std::size_t len)
+        {
+            detail::suggester sg(name, len);
+            for (const auto& o : s.specs)
+                sg.consider(o);
+            return sg.best;
+        }
+
+        bool add_args(int begin, int end)
+        {
+            detail::append_args(runs, first, nargs, begin, end);
+            return true;
+        }
+    };
+
+    if (commands)
+        flags |= stop_at_first_arg;
+    target t {*this, slots, runs, runs.size(), nargs, touched, lists, occurrences, errors};
+    error res = detail::parse_args(t, src, flags);
+    return detail::check_constraints(constraints, res, errors, flags, occurrences, touched, slots);
+}
+
+error schema::schema_impl::parse(detail::opt_slot* slots, detail::list_store& lists, std::vector<occurrence>* occurrences, error_list* errors, std::vector<detail::arg_run>& runs, std::size_t& nargs,
+        std::vector<std::uint32_t>* touched, int argc, const char* const* argv, unsigned flags) const
+{
+    if (argc < 1)
+        throw std::runtime_error("invalid argc value");
+    if (argv == nullptr)
+        throw std::runtime_error("invalid argv value");
+    detail::argv_source src {argc, argv, 1};
+    return parse(slots, lists, occurrences, errors, runs, nargs, touched, src, flags);
+}
+
+error schema::parse(int argc, const char* const* argv, result& r, unsigned flags) const
+{
+    const schema_impl* s = &_impl();
+    r._owner = s->arena._ptr;
+    r._progname = argc > 0 && argv != nullptr ? argv[0] : nullptr;
+    r._argv = argv;
+    r._runs.clear();
+    r._nargs = 0;
+    r._slots.assign(s->specs.size(), detail::opt_slot{});
+    r._lists.clear();
+    r._occurrences.clear();
+    r._errors.clear();
+    return s->parse(r._slots.data(), r._lists, &r._occurrences, &r._errors, r._runs, r._nargs, nullptr, argc, argv, flags);
+}
+
+error schema::parse(const char* buf, std::size_t len, result& r, unsigned flags) const
+{
+    if (buf == nullptr && len != 0)
+        throw std::runtime_error("invalid buf value");
+
+    r._args.clear();
+    detail::buffer_source src {buf, buf + len, r._args};
+    const char* progname = src.next();
+    if (progname == nullptr)
+        throw std::runtime_error("invalid len value");
+
+    const schema_impl* s = &_impl();
+    r._owner = s->arena._ptr;
+    r._progname = progname;
+    r._runs.clear();
+    r._nargs = 0;
+    r._slots.assign(s->specs.size(), detail::opt_slot{});
+    r._lists.clear();
+    r._occurrences.clear();
+    r._errors.clear();
+    error res = s->parse(r._slots.data(), r._lists, &r._occurrences, &r._errors, r._runs, r._nargs, nullptr, src, flags);
+    r._args.push_back(nullptr);
+    r._argv = nullptr;
+    return res;
+}
+
+void schema::parse_batch(std::size_t n, const int* argcs, const char* const* const* argvs,
+        batch_result& r, unsigned threads, unsigned flags) const
+{
+    const schema_impl* s = &_impl();
+
+    r._owner = s->arena._ptr;
+    r._errors.assign(n, error());
+    r._argv.assign(argvs, argvs + n);
+    r._nargs.assign(n, 0);
+    r._opts_end.assign(n, 0);
+    r._runs_end.assign(n, 0);
+
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    // Don't bother spawning threads for a handful of lines each.
+    const std::size_t min_per_thread = 64;
+    threads = static_cast<unsigned>(std::max<std::size_t>(1,
+            std::min<std::size_t>(threads, n / min_per_thread)));
+
+    // Every worker parses a contiguous range of argument lists. Errors and
+    // counts go straight into the shared arrays, options that were set and
+    // runs of positional arguments into the worker's own segment of the
+    // result, so nothing is copied after the workers are done. Segments
+    // keep their memory when the result is reused.
+    r._segments.resize(threads);
+    std::vector<std::exception_ptr> failures(threads);
+
+    auto work = [&](unsigned w) {
+        auto& seg = r._segments[w];
+        const std::size_t begin = n * w / threads;
+        const std::size_t end = n * (w + 1) / threads;
+        seg.first = begin;
+        seg.ids.clear();
+        seg.counts.clear();
+        seg.positions.clear();
+        seg.values.clear();
+        seg.nums.clear();
+        seg.runs.clear();
+        seg.lists.clear();
+        try {
+            std::vector<detail::opt_slot> slots(s->specs.size());
+            std::vector<std::uint32_t> touched;
+            for (std::size_t i = begin; i < end; ++i) {
+                r._errors[i] = s->parse(slots.data(), seg.lists, nullptr, nullptr, seg.runs, r._nargs[i], &touched, argcs[i], argvs[i], flags);
+                if (i == begin) {
+                    // Estimated from the first list, lists of a batch tend to be alike.
+                    const std::size_t size = (end - begin) * touched.size();
+                    seg.ids.reserve(size);
+                    seg.counts.reserve(size);
+                    seg.positions.reserve(size);
+                    seg.values.reserve(size);
+                    seg.nums.reserve(size);
+                    seg.runs.reserve((end - begin) * seg.runs.size());
+                }
+                for (auto id : touched) {
+                    auto& slot = slots[id];
+                    seg.ids.push_back(id);
+                    seg.counts.push_back(slot.count);
+                    seg.positions.push_back(slot.pos);
+                    seg.values.push_back(slot.value);
+                    seg.nums.push_back(slot.num);
+                    slot = detail::opt_slot{};
+                }
+                touched.clear();
+                r._opts_end[i] = seg.ids.size();
+                r._runs_end[i] = seg.runs.size();
+            }
+        } catch (...) {
+            failures[w] = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned w = 1; w < threads; ++w)
+        pool.emplace_back(work, w);
+    work(0);
+    for (auto& t : pool)
+        t.join();
+
+    for (auto& failure : failures)
+        if (failure)
+            std::rethrow_exception(failure);
+}
+
+const detail::opt_slot* result::_find(const detail::opt_base& o) const noexcept
+{
+    if (o._ptr == nullptr || o._ptr->pool != _owner || o._ptr->id >= _slots.size())
+        return nullptr;
+    return &_slots[o._ptr->id];
+}
+
+bool result::is_set(const detail::opt_base& o) const noexcept
+{
+    auto* s = _find(o);
+    return s != nullptr && s->count != 0;
+}
+
+std::size_t result::count(const detail::opt_base& o) const noexcept
+{
+    auto* s = _find(o);
+    return s != nullptr ? s->count : 0;
+}
+
+position result::position(const detail::opt_base& o) const noexcept
+{
+    auto* s = _find(o);
+    return s != nullptr ? s->pos : argparse::position();
+}
+
+const char* result::value(const detail::param_t& o, const char* fallback) const noexcept
+{
+    auto* s = _find(o);
+    return s == nullptr || s->value == nullptr ? fallback : s->value;
+}
+
+std::int64_t result::value(const detail::int_param_t& o, std::int64_t fallback) const noexcept
+{
+    auto* s = _find(o);
+    return s == nullptr || s->value == nullptr ? fallback : s->num.i;
+}
+
+double result::value(const detail::float_param_t& o, double fallback) const noexcept
+{
+    auto* s = _find(o);
+    return s == nullptr || s->value == nullptr ? fallback : s->num.f;
+}
+
+std::chrono::nanoseconds result::value(const detail::duration_param_t& o, std::chrono::nanoseconds fallback) const noexcept
+{
+    auto* s = _find(o);
+    return s == nullptr || s->value == nullptr ? fallback : std::chrono::nanoseconds{s->num.i};
+}
+
+std::uint64_t result::value(const detail::bytes_param_t& o, std::uint64_t fallback) const noexcept
+{
+    auto* s = _find(o);
+    return s == nullptr || s->value == nullptr ? fallback : s->num.u;
+}
+
+list_view result::values(const detail::list_param_t& o) const noexcept
+{
+    auto* s = _find(o);
+    return s == nullptr || s->value == nullptr ? list_view() : list_view(&_lists, s->num.u);
+}
+
+const batch_result::segment& batch_result::_segment(std::size_t i) const noexcept
+{
+    // Binary search for the last segment that starts at or before i.
+    std::size_t lo = 0, hi = _segments.size();
+    while (hi - lo > 1) {
+        std::size_t mid = lo + (hi - lo) / 2;
+        if (_segments[mid].first <= i)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return _segments[lo];
+}
+
+const batch_result::segment* batch_result::_find(std::size_t i, const detail::opt_base& o, std::size_t& j) const noexcept
+{
+    if (o._ptr == nullptr || o._ptr->pool != _owner)
+        return nullptr;
+    const segment& seg = _segment(i);
+    // Only a few options are set on a typical command line, a scan is enough.
+    for (j = i != seg.first ? _opts_end[i - 1] : 0; j < _opts_end[i]; ++j)
+        if (seg.ids[j] == o._ptr->id)
+            return &seg;
+    return nullptr;
+}
+
+bool batch_result::is_set(std::size_t i, const detail::opt_base& o) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg != nullptr && seg->counts[j] != 0;
+}
+
+std::size_t batch_result::count(std::size_t i, const detail::opt_base& o) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg != nullptr ? seg->counts[j] : 0;
+}
+
+position batch_result::position(std::size_t i, const detail::opt_base& o) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg != nullptr ? seg->positions[j] : argparse::position();
+}
+
+const char* batch_result::value(std::size_t i, const detail::param_t& o, const char* fallback) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg == nullptr || seg->values[j] == nullptr ? fallback : seg->values[j];
+}
+
+std::int64_t batch_result::value(std::size_t i, const detail::int_param_t& o, std::int64_t fallback) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg == nullptr || seg->values[j] == nullptr ? fallback : seg->nums[j].i;
+}
+
+double batch_result::value(std::size_t i, const detail::float_param_t& o, double fallback) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg == nullptr || seg->values[j] == nullptr ? fallback : seg->nums[j].f;
+}
+
+std::chrono::nanoseconds batch_result::value(std::size_t i, const detail::duration_param_t& o,
+        std::chrono::nanoseconds fallback) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg == nullptr || seg->values[j] == nullptr ? fallback : std::chrono::nanoseconds{seg->nums[j].i};
+}
+
+std::uint64_t batch_result::value(std::size_t i, const detail::bytes_param_t& o, std::uint64_t fallback) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg == nullptr || seg->values[j] == nullptr ? fallback : seg->nums[j].u;
+}
+
+list_view batch_result::values(std::size_t i, const detail::list_param_t& o) const noexcept
+{
+    std::size_t j;
+    auto* seg = _find(i, o, j);
+    return seg == nullptr || seg->values[j] == nullptr ? list_view() : list_view(&seg->lists, seg->nums[j].u);
+}
+
+args_view batch_result::args(std::size_t i) const
+{
+    const segment& seg = _segment(i);
+    const std::size_t begin = i != seg.first ? _runs_end[i - 1] : 0;
+    return args_view(_argv[i], seg.runs.data() + begin, _runs_end[i] - begin, _nargs[i]);
+}
+
+void command_line::split(const char* str)
+{
+    if (str == nullptr)
+        throw std::runtime_error("invalid str value");
+    split(str, std::strlen(str));
+}
+
+void command_line::split(const char* str, std::size_t len)
+{
+    if (str == nullptr && len != 0)
+        throw std::runtime_error("invalid str value");
+    // Arguments never take more room than the input, plus the spare byte
+    // split_in_place needs for the last terminator.
+    _buf.resize(len + 1);
+    if (len != 0)
+        std::memcpy(_buf.data(), str, len);
+    _argv.clear();
+    detail::split_in_place(_buf.data(), len, _argv);
+    if (_argv.size() >= static_cast<std::size_t>(INT_MAX))
+        throw std::length_error("too many arguments");
+    _argv.push_back(nullptr);
+}
+
+response_files::~response_files()
+{
+    for (auto& f : _files)
+        detail::free_file(f);
+}
+
+void response_files::expand(int argc, const char* const* argv)
+{
+    if (argc < 1)
+        throw std::runtime_error("invalid argc value");
+    if (argv == nullptr)
+        throw std::runtime_error("invalid argv value");
+    for (auto& f : _files)
+        detail::free_file(f);
+    _files.clear();
+    detail::expand_response_files(argc, argv, _argv, _files);
 }
 
 } // namespace argparse
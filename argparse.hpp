@@ -1,19 +1,183 @@
 // Argument parsing library
 // License: UNLICENSE <https://www.unlicense.org>
 // Website: https://github.com/ii14/argparse
+//
+// Define ARGPARSE_SINGLE_THREADED when building argparse.cpp to use plain,
+// non-atomic reference counts for option handles. Handles from one parser
+// then must not be copied or destroyed concurrently from multiple threads.
+//
+// Define ARGPARSE_NO_SIMD to build the command line tokenizer without
+// SSE2/AVX2. AVX2 is used when the compiler targets it, eg. with -mavx2.
 
 #ifndef ARGPARSE_HPP
 #define ARGPARSE_HPP
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <iterator>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <initializer_list>
 
 namespace argparse {
 
 struct parser;
+struct schema;
+struct result;
+struct batch_result;
+struct list_view;
+
+/// Where an option was found: index in argv, and for short options the
+/// offset of the letter in the argument, eg. 2 for "b" in "-ab".
+/// Long options have offset 0. Default constructed position, with index 0,
+/// means the option was not present. Ordered by index, then offset.
+struct position
+{
+    constexpr position() {}
+    constexpr position(std::uint32_t index, std::uint32_t offset)
+        : index{index}, offset{offset} {}
+
+    /// True if option was present.
+    constexpr bool valid() const noexcept { return index != 0; }
+
+    constexpr bool operator==(const position& b) const noexcept { return index == b.index && offset == b.offset; }
+    constexpr bool operator!=(const position& b) const noexcept { return !(*this == b); }
+    constexpr bool operator<(const position& b) const noexcept { return index < b.index || (index == b.index && offset < b.offset); }
+    constexpr bool operator>(const position& b) const noexcept { return b < *this; }
+    constexpr bool operator<=(const position& b) const noexcept { return !(b < *this); }
+    constexpr bool operator>=(const position& b) const noexcept { return !(*this < b); }
+
+    std::uint32_t index {0};
+    std::uint32_t offset {0};
+};
+
+/// Single occurrence of an option, in order of appearance.
+struct occurrence
+{
+    std::uint32_t id; ///< Option id, see opt_base::id().
+    position pos;
+};
 
 namespace detail {
 
+enum class opt_type : std::uint8_t
+{
+    param,
+    flag,
+    category,
+    list,
+};
+
+/// How param values are converted during parsing.
+enum class value_kind : std::uint8_t
+{
+    string,   ///< Not converted.
+    integer,  ///< Signed decimal, opt_number::i.
+    real,     ///< Decimal floating point, opt_number::f.
+    duration, ///< Number of nanoseconds, opt_number::i.
+    bytes,    ///< Number of bytes, opt_number::u.
+};
+
+/// Kind and names of an option, everything needed to match it in argv.
+struct opt_spec
+{
+    opt_type type;
+    char shortname;
+    const char* longname;
+    std::size_t longlen;
+    value_kind kind;
+    char delimiter; ///< Separator of list values, 0 if they are not split.
+    std::uint64_t hist; ///< Character histogram of the long name, see name_hist().
+};
+
+/// Converted value of a typed param.
+union opt_number
+{
+    std::int64_t i;
+    std::uint64_t u;
+    double f;
+};
+
+/// Parse results of an option.
+struct opt_slot
+{
+    const char* value {nullptr}; ///< Last value of a param.
+    opt_number num {};
+    std::uint32_t count {0};     ///< Number of occurrences.
+    position pos;                ///< Last occurrence.
+};
+
+struct opt_arena;
+
+/// Values of list params, collected while parsing.
+/// The first values of every list are stored inline, the rest spill to
+/// blocks in a shared array. Values split out of a longer argument are
+/// copied to a shared byte buffer. Everything is addressed by offsets, so
+/// the store can be copied and appended to other stores.
+struct list_store
+{
+    static constexpr std::size_t inline_size = 4;
+
+    /// Value, a pointer into argv, or an offset in bytes if ptr is nullptr.
+    struct item
+    {
+        const char* ptr;
+        std::size_t offset;
+    };
+
+    struct list
+    {
+        std::uint32_t size;
+        std::uint32_t spill_cap; ///< Capacity of the spill block.
+        std::size_t spill;       ///< Offset of the spill block in spilled.
+        item items[inline_size];
+    };
+
+    /// Creates an empty list, returns its index.
+    std::size_t create();
+
+    /// Appends value to list l, split at delimiter if it's not 0.
+    void add(std::size_t l, const char* value, char delimiter);
+
+    /// Value i of list l.
+    const char* get(std::size_t l, std::size_t i) const noexcept;
+
+    /// Removes all lists, keeps the memory.
+    void clear() noexcept;
+
+    /// Appends all lists of b, returns the index of the first one.
+    std::size_t append(const list_store& b);
+
+    std::vector<list> lists;
+    std::vector<item> spilled;
+    std::vector<char> bytes;
+
+private:
+    void _push(std::size_t l, item v);
+};
+
+/// Shared reference to the storage of option records.
+/// The parser and every option handle keep the storage alive.
+struct arena_ref
+{
+    arena_ref() {}
+
+    arena_ref(const arena_ref& b);
+    arena_ref& operator=(const arena_ref& b);
+    arena_ref(arena_ref&& b) noexcept;
+    arena_ref& operator=(arena_ref&& b) noexcept;
+    ~arena_ref();
+
+private:
+    opt_arena* _ptr {nullptr};
+    friend struct argparse::parser;
+    friend struct argparse::schema;
+};
+
 struct opt_base
 {
     opt_base() {}
@@ -35,16 +199,47 @@ struct opt_base
     /// Option description.
     const char* description() const noexcept;
 
+    /// Name of the value shown in the help page, eg. "FILE" for
+    /// "--output FILE". Params without one get a name for their type, like
+    /// "INT" or "VALUE". Returns nullptr for flags.
+    const char* metavar() const noexcept;
+
     /// True if option was present in arguments.
     bool is_set() const noexcept;
 
     /// True if option was present in arguments.
     operator bool() const noexcept { return is_set(); }
 
+    /// Number of times option was present in arguments.
+    /// Every letter of a bundle like "-vvv" counts.
+    std::size_t count() const noexcept;
+
+    /// Position of the last occurrence of the option in arguments.
+    argparse::position position() const noexcept;
+
+    /// Registration number of the option, unique within its parser.
+    std::uint32_t id() const noexcept;
+
 protected:
     struct opt_impl;
     opt_impl* _ptr {nullptr};
     friend struct argparse::parser;
+    friend struct argparse::schema;
+    friend struct argparse::result;
+    friend struct argparse::batch_result;
+    friend struct opt_arena;
+};
+
+/// Compares positions of the last occurrences of options.
+/// Options that were not present come first.
+inline bool operator<(const opt_base& a, const opt_base& b) noexcept { return a.position() < b.position(); }
+inline bool operator>(const opt_base& a, const opt_base& b) noexcept { return a.position() > b.position(); }
+
+/// Slot of the long name hash index.
+struct index_entry
+{
+    std::uint32_t hash {0};
+    std::uint32_t pos {0}; ///< Position in the option list + 1, 0 if empty.
 };
 
 struct param_t : opt_base
@@ -62,6 +257,100 @@ struct param_t : opt_base
     friend struct argparse::parser;
 };
 
+/// Param converted to a signed 64-bit integer, eg. "-42".
+struct int_param_t : opt_base
+{
+    int_param_t() {}
+
+    /// Option value.
+    /// Returns fallback value if option was not set.
+    std::int64_t value(std::int64_t fallback = 0) const noexcept;
+
+    /// Option value.
+    /// Returns 0 if option was not set.
+    std::int64_t operator*() const noexcept { return value(); }
+
+    friend struct argparse::parser;
+};
+
+/// Param converted to a double, eg. "1.5e-3".
+/// Decimal point is always '.', regardless of the locale.
+struct float_param_t : opt_base
+{
+    float_param_t() {}
+
+    /// Option value.
+    /// Returns fallback value if option was not set.
+    double value(double fallback = 0) const noexcept;
+
+    /// Option value.
+    /// Returns 0 if option was not set.
+    double operator*() const noexcept { return value(); }
+
+    friend struct argparse::parser;
+};
+
+/// Param converted to a duration, eg. "250ms" or "1h30m".
+/// Units are ns, us, ms, s, m and h, a number without a unit is seconds.
+struct duration_param_t : opt_base
+{
+    duration_param_t() {}
+
+    /// Option value.
+    /// Returns fallback value if option was not set.
+    std::chrono::nanoseconds value(std::chrono::nanoseconds fallback = std::chrono::nanoseconds{0}) const noexcept;
+
+    /// Option value.
+    /// Returns 0 if option was not set.
+    std::chrono::nanoseconds operator*() const noexcept { return value(); }
+
+    friend struct argparse::parser;
+};
+
+/// Param converted to a byte size, eg. "512", "64K" or "1.5GiB".
+/// Suffixes K, M, G, T, P and E are powers of 1024, and can be followed by
+/// "B" or "iB". k is the same as K.
+struct bytes_param_t : opt_base
+{
+    bytes_param_t() {}
+
+    /// Option value.
+    /// Returns fallback value if option was not set.
+    std::uint64_t value(std::uint64_t fallback = 0) const noexcept;
+
+    /// Option value.
+    /// Returns 0 if option was not set.
+    std::uint64_t operator*() const noexcept { return value(); }
+
+    friend struct argparse::parser;
+};
+
+/// Param that collects every occurrence, eg. "-I a -I b". With a delimiter,
+/// every value is also split into more values, eg. "--ids 1,2,3".
+struct list_param_t : opt_base
+{
+    list_param_t() {}
+
+    /// Collected values, empty if option was not set.
+    list_view values() const noexcept;
+
+    friend struct argparse::parser;
+};
+
+/// Flag that counts its occurrences, eg. 3 for "-vvv" or "-v -vv".
+struct counter_t : opt_base
+{
+    counter_t() {}
+
+    /// Option value. Same as count().
+    std::size_t value() const noexcept { return count(); }
+
+    /// Option value. Same as count().
+    std::size_t operator*() const noexcept { return count(); }
+
+    friend struct argparse::parser;
+};
+
 struct flag_t : opt_base
 {
     flag_t() {}
@@ -78,29 +367,217 @@ struct flag_t : opt_base
 struct names_t
 {
     /// Short name, eg. "-a".
-    names_t(char shortname)
+    constexpr names_t(char shortname)
         : shortname{shortname} {}
 
     /// Long name, eg. "--opt-a".
-    names_t(const char* longname)
+    constexpr names_t(const char* longname)
         : longname{longname} {}
 
     /// Short and long name, eg. "-a" and "--opt-a".
-    names_t(char shortname, const char* longname)
+    constexpr names_t(char shortname, const char* longname)
         : shortname{shortname}, longname{longname} {}
 
     char shortname {0};
     const char* longname {nullptr};
 };
 
+/// Contents of a response file, memory mapped or read into a heap buffer.
+struct file_buffer
+{
+    char* data;
+    std::size_t size;
+    std::size_t mapped; ///< Length of the mapping, 0 if data is a heap buffer.
+};
+
+/// Run of consecutive positional arguments in argv.
+struct arg_run
+{
+    std::uint32_t begin;  ///< Index in argv of the first argument of the run.
+    std::uint32_t offset; ///< Number of positional arguments before the run.
+};
+
 } // namespace detail
 
+/// Positional arguments, as a view over argv.
+/// Consecutive arguments are stored as a single run of argv indexes, so
+/// the memory used depends on how many times options and arguments
+/// alternate, not on the number of arguments. Valid as long as argv and
+/// the object it was returned from are.
+struct args_view
+{
+    struct iterator
+    {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = const char*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const char* const*;
+        using reference = const char* const&;
+
+        reference operator*() const { return _v->_argv[_v->_runs[_run].begin + (_pos - _v->_runs[_run].offset)]; }
+        pointer operator->() const { return &**this; }
+
+        iterator& operator++()
+        {
+            if (++_pos < _v->_size && _run + 1 < _v->_nruns && _v->_runs[_run + 1].offset == _pos)
+                ++_run;
+            return *this;
+        }
+
+        iterator operator++(int) { iterator it = *this; ++*this; return it; }
+
+        bool operator==(const iterator& b) const { return _pos == b._pos; }
+        bool operator!=(const iterator& b) const { return _pos != b._pos; }
+
+    private:
+        iterator(const args_view* v, std::size_t pos) : _v{v}, _pos{pos} {}
+
+        const args_view* _v;
+        std::size_t _pos;
+        std::size_t _run {0};
+        friend struct args_view;
+    };
+
+    args_view() {}
+
+    args_view(const char* const* argv, const detail::arg_run* runs, std::size_t nruns, std::size_t size)
+        : _argv{argv}, _runs{runs}, _nruns{nruns}, _size{size} {}
+
+    /// Number of arguments.
+    std::size_t size() const noexcept { return _size; }
+
+    /// True if there are no arguments.
+    bool empty() const noexcept { return _size == 0; }
+
+    /// Argument number i.
+    const char* operator[](std::size_t i) const noexcept { return _argv[index(i)]; }
+
+    /// Pointer to the arguments in argv if there are any and they are all
+    /// consecutive, which is always the case with stop_at_first_arg.
+    /// nullptr otherwise, also if there are no arguments, so check empty()
+    /// before passing it on, eg. to execvp().
+    /// Arguments that run to the end of argv are followed by argv[argc], which is nullptr.
+    const char* const* data() const noexcept { return _nruns == 1 ? _argv + _runs[0].begin : nullptr; }
+
+    /// Index in argv of argument number i.
+    std::size_t index(std::size_t i) const noexcept
+    {
+        // Binary search for the last run that starts at or before i.
+        std::size_t lo = 0, hi = _nruns;
+        while (hi - lo > 1) {
+            std::size_t mid = lo + (hi - lo) / 2;
+            if (_runs[mid].offset <= i)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return _runs[lo].begin + (i - _runs[lo].offset);
+    }
+
+    iterator begin() const noexcept { return iterator(this, 0); }
+    iterator end() const noexcept { return iterator(this, _size); }
+
+private:
+    const char* const* _argv {nullptr};
+    const detail::arg_run* _runs {nullptr};
+    std::size_t _nruns {0};
+    std::size_t _size {0};
+};
+
+/// Values of a list param.
+/// Valid as long as argv and the object it was returned from are.
+struct list_view
+{
+    struct iterator
+    {
+        using iterator_category = std::input_iterator_tag;
+        using value_type = const char*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const char* const*;
+        using reference = const char*;
+
+        reference operator*() const { return (*_v)[_pos]; }
+        iterator& operator++() { ++_pos; return *this; }
+        iterator operator++(int) { iterator it = *this; ++_pos; return it; }
+        bool operator==(const iterator& b) const { return _pos == b._pos; }
+        bool operator!=(const iterator& b) const { return _pos != b._pos; }
+
+    private:
+        iterator(const list_view* v, std::size_t pos) : _v{v}, _pos{pos} {}
+        const list_view* _v;
+        std::size_t _pos;
+        friend struct list_view;
+    };
+
+    list_view() {}
+    list_view(const detail::list_store* store, std::size_t list)
+        : _store{store}, _list{list} {}
+
+    /// Number of values.
+    std::size_t size() const noexcept { return _store != nullptr ? _store->lists[_list].size : 0; }
+
+    /// True if there are no values.
+    bool empty() const noexcept { return size() == 0; }
+
+    /// Value i.
+    const char* operator[](std::size_t i) const noexcept { return _store->get(_list, i); }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, size()); }
+
+private:
+    const detail::list_store* _store {nullptr};
+    std::size_t _list {0};
+};
+
+/// Shells that parser::completion_script() generates scripts for.
+enum class shell
+{
+    bash,
+    zsh,
+    fish,
+};
+
+/// Flags changing how arguments are parsed. Can be combined with |.
+enum parse_flags : unsigned
+{
+    /// Stop parsing options at the first positional argument, like "+" in
+    /// getopt or POSIXLY_CORRECT. The argument and everything after it are
+    /// returned as positional arguments, for example the command and its
+    /// arguments in "wrapper [opts] cmd args...".
+    stop_at_first_arg = 1u << 0,
+
+    /// Replace "@path" arguments with arguments read from the file at path.
+    /// See response_files for details. Only supported by parser::parse,
+    /// use response_files directly with other parsers.
+    expand_response_files = 1u << 1,
+
+    /// Don't stop at the first error. Offending options and arguments are
+    /// skipped, and every error is stored in the errors() of the parser or
+    /// result. The parse function still returns the first error.
+    /// Batch parsing only keeps the first error of every argument list.
+    collect_errors = 1u << 2,
+
+    /// Accept unambiguous abbreviations of long options, like GNU getopt,
+    /// eg. "--verb" for "--verbose". Abbreviations that match more than one
+    /// option are reported as error::ambiguous_option. Not supported by
+    /// static_parser.
+    allow_abbreviations = 1u << 3,
+};
+
 struct error
 {
     enum error_type : std::uint8_t {
         ok = 0,
         unknown_option = 1,
         missing_argument = 2,
+        too_many_arguments = 3,
+        unexpected_argument = 4,
+        invalid_value = 5,
+        unknown_command = 6,
+        ambiguous_option = 7,
+        missing_option = 8,
+        conflicting_options = 9,
     };
 
     explicit error()
@@ -115,30 +592,234 @@ struct error
     explicit error(error_type type, const char* longname)
         : _type{type}, _longname{longname} {}
 
+    /// Unknown long option or command with the closest registered name, or
+    /// a constraint violation between two options.
+    explicit error(error_type type, const char* longname, const char* other)
+        : _type{type}, _longname{longname}, _other{other} {}
+
+    /// Ambiguous abbreviation of a long option, with count matching names.
+    explicit error(error_type type, const char* longname, const char* candidates, std::size_t count)
+        : _type{type}, _ncandidates{static_cast<std::uint32_t>(count)}, _longname{longname}, _candidates{candidates} {}
+
     /// True if parsing succeeded.
     operator bool() const { return _type == error_type::ok; }
 
     /// Error type.
     error_type type() const { return _type; }
 
-    /// Option name where the error occurred.
+    /// Option name where the error occurred, or the command name.
+    /// Long options given as "--my-arg=x" include the "=x" part.
     const char* optname() const { return _longname == nullptr ? _shortname : _longname; }
 
+    /// For unknown long options and commands, the closest registered name,
+    /// without dashes, if there is one close enough. Otherwise nullptr.
+    const char* suggestion() const
+    {
+        return _type == unknown_option || _type == unknown_command ? _other : nullptr;
+    }
+
+    /// For conflicting_options, the option that conflicts with optname().
+    /// For missing_option, the option that requires optname(), if any.
+    /// Otherwise nullptr. Names of both point into the parser or schema.
+    const char* other() const
+    {
+        return _type == missing_option || _type == conflicting_options ? _other : nullptr;
+    }
+
+    /// For ambiguous abbreviations, number of long options they match.
+    /// For missing_option of an exactly_one() group, number of its options.
+    std::size_t ncandidates() const { return _ncandidates; }
+
+    /// For ambiguous abbreviations, the long options they match, with
+    /// dashes, one after another and each terminated with NUL, eg.
+    /// "--verbose\0--version\0". For missing_option of an exactly_one()
+    /// group, its options. Otherwise nullptr. Points into the parser or
+    /// schema, valid until more options are registered.
+    const char* candidates() const { return _candidates; }
+
     /// String representation of the error.
     std::string str() const;
 
+    /// Writes the string representation of the error into buf, like
+    /// snprintf: at most size - 1 characters and a terminating NUL, if size
+    /// is not 0. Returns the length of the full string. Doesn't allocate.
+    std::size_t format(char* buf, std::size_t size) const noexcept;
+
 private:
     error_type _type {error_type::ok};
     char _shortname[3] {0};
+    std::uint32_t _ncandidates {0};
     const char* _longname {nullptr};
+    const char* _other {nullptr};
+    const char* _candidates {nullptr};
 };
 
+/// Errors collected with the collect_errors flag.
+/// Keeps the first `capacity` errors inline, and only counts the rest.
+struct error_list
+{
+    static constexpr std::size_t capacity = 16;
+
+    /// Number of stored errors.
+    std::size_t size() const noexcept { return _size; }
+
+    /// True if there are no errors.
+    bool empty() const noexcept { return _total == 0; }
+
+    /// Number of all errors, including the ones that didn't fit.
+    std::size_t total() const noexcept { return _total; }
+
+    const error& operator[](std::size_t i) const noexcept { return _items[i]; }
+    const error* begin() const noexcept { return _items; }
+    const error* end() const noexcept { return _items + _size; }
+
+    /// Adds an error, or counts it if the list is full.
+    void add(const error& e) noexcept
+    {
+        if (_size < capacity)
+            _items[_size++] = e;
+        ++_total;
+    }
+
+    /// Adds all errors of another list, including the ones it only counted.
+    void add(const error_list& b) noexcept
+    {
+        for (const auto& e : b)
+            add(e);
+        _total += b._total - b._size;
+    }
+
+    void clear() noexcept { _size = _total = 0; }
+
+private:
+    error _items[capacity];
+    std::size_t _size {0};
+    std::size_t _total {0};
+};
+
+namespace detail {
+
+/// Subcommand, see parser::command().
+struct command
+{
+    opt_spec spec; ///< Name of the command, matched like a long option name.
+    const char* desc;
+    std::function<void(parser&)> factory;
+    std::shared_ptr<parser> sub; ///< Created when the command is selected.
+};
+
+/// Prefix tree over names of options and commands, as they are typed:
+/// "--name", "-a" and "name". Names are kept sorted, also in buf, so the
+/// names under every node are a range of entries, and a run of strings.
+struct name_trie
+{
+    enum kind_t : std::uint8_t { long_opt, short_opt, command };
+
+    struct entry
+    {
+        std::uint32_t offset; ///< Offset of the name in buf, NUL terminated.
+        std::uint32_t len;
+        std::uint32_t id;     ///< Position of the option or command.
+        kind_t kind;
+    };
+
+    struct node
+    {
+        std::uint32_t child;  ///< First child, children are next to each other.
+        std::uint32_t begin;  ///< Entries starting with the prefix of this node.
+        std::uint32_t end;
+        std::uint16_t nchild;
+        char c;
+    };
+
+    /// True if nothing was built yet.
+    bool empty() const noexcept { return nodes.empty(); }
+
+    void clear() noexcept;
+
+    /// Adds prefix + name, eg. "--" and "verbose". Names are added before build().
+    void add(const char* prefix, const char* name, std::size_t len, std::uint32_t id, kind_t kind);
+
+    /// Sorts the names and builds the tree.
+    void build();
+
+    /// Finds entries whose names start with prefix, [begin, end).
+    void find(const char* prefix, std::size_t len, std::size_t& begin, std::size_t& end) const noexcept;
+
+    /// Node reached from n by following s, nullptr if there is none.
+    /// The root is nodes[0].
+    const node* walk(const node* n, const char* s, std::size_t len) const noexcept;
+
+    const char* name(const entry& e) const noexcept { return buf.data() + e.offset; }
+
+    std::string buf;
+    std::vector<entry> entries;
+    std::vector<node> nodes;
+};
+
+/// Constraints between options, declared as lists of option ids, then
+/// compiled into bitmasks over option ids. Masks only keep the words that
+/// have bits set, so checking a constraint takes a few word-wide operations
+/// on a bitmask of options that were present, however many options exist.
+struct constraint_set
+{
+    enum kind_t : std::uint8_t { required, exclusive, exactly_one, depends };
+
+    struct rule
+    {
+        kind_t kind;
+        std::uint32_t subject; ///< Option that depends on the others.
+        std::uint32_t begin;   ///< Options of the rule, range of ids.
+        std::uint32_t end;
+        std::uint32_t names;   ///< Offset of names of the options in names.
+        std::uint32_t mask_begin; ///< Range of masks.
+        std::uint32_t mask_end;
+    };
+
+    struct mask
+    {
+        std::uint32_t word;
+        std::uint64_t bits;
+    };
+
+    bool empty() const noexcept { return rules.empty(); }
+
+    void add(kind_t kind, std::uint32_t subject, const std::vector<std::uint32_t>& opts);
+
+    /// Compiles the masks and names. specs are indexed by option id.
+    void build(const std::vector<opt_spec>& specs);
+
+    /// Number of words of a bitmask.
+    std::size_t words() const noexcept { return _words; }
+
+    /// Checks constraints against a bitmask of options that were present.
+    /// Returns the first violation, and if errors is set, adds all of them.
+    error check(const std::uint64_t* present, error_list* errors) const;
+
+    std::vector<rule> rules;
+    std::vector<std::uint32_t> ids;
+    std::vector<mask> masks;            ///< Ordered by word within a rule.
+    std::vector<std::uint32_t> name_at; ///< Offset of name in names, by option id.
+    std::string names; ///< "--name" or "-a", each terminated with NUL.
+
+private:
+    std::size_t _words {0};
+};
+
+} // namespace detail
+
 struct parser
 {
     parser() {}
 
     using param_t = detail::param_t;
+    using int_param_t = detail::int_param_t;
+    using float_param_t = detail::float_param_t;
+    using duration_param_t = detail::duration_param_t;
+    using bytes_param_t = detail::bytes_param_t;
+    using list_param_t = detail::list_param_t;
     using flag_t = detail::flag_t;
+    using counter_t = detail::counter_t;
     using names_t = detail::names_t;
     using opt_base = detail::opt_base;
 
@@ -147,39 +828,636 @@ struct parser
     /// Short name has to match [0-9A-Za-z].
     flag_t flag(names_t names, const char* desc = nullptr);
 
+    /// Creates a flag that counts its occurrences, eg. for "-vvv".
+    /// Same requirements as flag().
+    counter_t counter(names_t names, const char* desc = nullptr);
+
     /// Creates a parameter option.
     /// Either short or long name has to be set.
     /// Short name has to match [0-9A-Za-z].
-    param_t param(names_t names, const char* desc = nullptr);
+    /// metavar is the name of the value in the help page, see opt_base::metavar().
+    param_t param(names_t names, const char* desc = nullptr, const char* metavar = nullptr);
+
+    /// Creates params that are converted when parsing. See int_param_t,
+    /// float_param_t, duration_param_t and bytes_param_t for formats.
+    /// Values that fail to convert are reported as error::invalid_value.
+    int_param_t int_param(names_t names, const char* desc = nullptr, const char* metavar = nullptr);
+    float_param_t float_param(names_t names, const char* desc = nullptr, const char* metavar = nullptr);
+    duration_param_t duration_param(names_t names, const char* desc = nullptr, const char* metavar = nullptr);
+    bytes_param_t bytes_param(names_t names, const char* desc = nullptr, const char* metavar = nullptr);
+
+    /// Creates a param that collects all of its values. If delimiter is not
+    /// 0, values are also split at every delimiter.
+    list_param_t list_param(names_t names, const char* desc = nullptr, char delimiter = 0,
+            const char* metavar = nullptr);
 
     /// Creates a category.
     /// name is required to be a valid string.
     void category(const char* name);
 
-    /// Parses argv.
+    /// Constraints checked after parsing, by parse() and by schemas compiled
+    /// afterwards: o has to be present, at most one of opts can be present,
+    /// exactly one of opts has to be present, and if o is present, all of
+    /// opts have to be present too. Violations are reported as
+    /// error::missing_option or error::conflicting_options.
+    /// Options have to come from this parser. compile() and parse() throw
+    /// std::logic_error if an option was shadowed by a later one with the
+    /// same names.
+    void required(const opt_base& o);
+    void exclusive(std::initializer_list<opt_base> opts);
+    void exactly_one(std::initializer_list<opt_base> opts);
+    void depends(const opt_base& o, std::initializer_list<opt_base> opts);
+
+    /// Registers a subcommand, eg. "build" in "prog -v build -j4".
+    /// If a parser has commands, parse() stops at the first argument that is
+    /// not an option, and looks it up as a command. Arguments from there on
+    /// are parsed by a new parser, after factory registers options into it,
+    /// and are also left in args() of this parser. Factories of commands
+    /// that were not selected are never called.
+    /// Commands can have commands of their own. With collect_errors, errors
+    /// of the command are also added to errors() of this parser.
+    void command(const char* name, std::function<void(parser&)> factory, const char* desc = nullptr);
+
+    /// Name of the command selected by parse(), nullptr if there was none.
+    const char* command_name() const;
+
+    /// Parser of the command selected by parse(), nullptr if there was none.
+    /// Its progname() is the command name, and it has the arguments after it.
+    const parser* subparser() const;
+
+    /// Completes the last argument, which is the word under the cursor in
+    /// a shell. argv[0] is the program name. Candidates are long options
+    /// "--name", short options "-a", and commands, in sorted order, pointing
+    /// into storage of the parser that is valid until more options or
+    /// commands are registered. Commands in argv are followed into their
+    /// parsers, running their factories. Option values and positional
+    /// arguments get no candidates, shells fall back to file names.
+    /// Returns the number of candidates appended to out.
+    std::size_t complete(int argc, const char* const* argv, std::vector<const char*>& out);
+
+    /// Answers completion requests of scripts from completion_script().
+    /// If argv[1] is "__complete", writes candidates for the rest of argv
+    /// to a file descriptor, one per line, and returns true. The program
+    /// should exit then, so call it right after registering options and
+    /// before any other initialization. Otherwise returns false.
+    bool handle_completion(int argc, const char* const* argv, int fd = 1);
+
+    /// Shell script that registers completion for progname, by running the
+    /// program with "__complete" as the first argument. See handle_completion().
+    static std::string completion_script(shell sh, const char* progname);
+
+    /// Help page with the list of options and their descriptions, grouped
+    /// by categories, followed by commands. Categories without options are
+    /// left out. Descriptions are wrapped to fit in width columns, and can
+    /// contain newlines. The page is rendered once and kept until more
+    /// options are registered. Rendering writes to the parser, so despite
+    /// being const, this must not be called from multiple threads at once.
+    const std::string& help(std::size_t width = 80) const;
+
+    /// Writes the help page to a file descriptor, eg. 1 for stdout, with a
+    /// single write call. Returns false if writing failed.
+    /// Renders the page like help(), with the same thread safety.
+    bool print_help(int fd = 1, std::size_t width = 80) const;
+
+    /// Parses argv. flags is a combination of parse_flags.
     /// Can throw exception on unexpected conditions, like invalid argc/argv.
     /// Can be called only once per instance of this class.
-    error parse(int argc, const char* const* argv);
+    error parse(int argc, const char* const* argv, unsigned flags = 0);
+
+    /// Parses arguments from a buffer of len bytes, where every argument,
+    /// starting with the program name, is terminated with a NUL character,
+    /// like in /proc/<pid>/cmdline or `xargs -0` input. The buffer is walked
+    /// in place, option values and arguments point into it.
+    /// Response files are not expanded.
+    /// Can throw exception on unexpected conditions, like an empty buffer
+    /// or an unterminated last argument.
+    /// Can be called only once per instance of this class.
+    error parse(const char* buf, std::size_t len, unsigned flags = 0);
+
+    /// Freezes currently registered options into a schema, that can parse
+    /// any number of argument lists, from any number of threads.
+    /// Options registered afterwards don't affect the returned schema.
+    /// Schemas don't dispatch commands. If this parser has commands, the
+    /// schema always parses with stop_at_first_arg, so the command and its
+    /// arguments are left in args() for the caller to dispatch.
+    /// Like opts(), it may compact the option list, so calls on the same
+    /// parser must not run from multiple threads at once.
+    schema compile() const;
 
     /// Returns program name, argv[0].
     /// Returns nullptr if it's not known yet ie. parse() was not called yet.
     const char* progname() const { return _progname; }
 
-    /// List of all options.
-    const std::vector<opt_base>& opts() const { return _opts; }
+    /// Every occurrence of an option, in order of appearance.
+    const std::vector<occurrence>& occurrences() const { return _occurrences; }
+
+    /// Errors collected with the collect_errors flag.
+    const error_list& errors() const { return _errors; }
+
+    /// List of all options. Drops shadowed options from the list first,
+    /// so despite being const, this must not be called from multiple
+    /// threads at once.
+    const std::vector<opt_base>& opts() const
+    {
+        if (_shadowed != 0)
+            _compact();
+        return _opts;
+    }
 
     /// List of arguments.
-    const std::vector<const char*>& args() const { return _args; }
+    args_view args() const { return args_view(_argv, _runs.data(), _runs.size(), _nargs); }
 
 private:
+    detail::opt_base::opt_impl* _alloc();
     void _remove_duplicates(const names_t& names);
+    void _add(detail::opt_base& o, names_t names, const char* desc,
+            detail::opt_type type, detail::value_kind kind);
+    void _compact() const;
+    void _insert_long(detail::opt_base::opt_impl* o, std::size_t pos) const;
+    void _erase_long_slot(std::size_t slot);
+    std::size_t _find_long_slot(const char* name, std::size_t len, std::uint32_t hash) const noexcept;
+    detail::opt_base::opt_impl* _find_long(const char* name, std::size_t len) const noexcept;
+    template <typename Source>
+    error _parse(Source& src, unsigned flags);
+    error _dispatch(error res, unsigned flags);
+    const detail::name_trie& _names() const;
+    std::vector<detail::opt_spec> _specs() const;
+    void _constrain(detail::constraint_set::kind_t kind, const opt_base* subject,
+            std::initializer_list<opt_base> opts);
+
+private:
+    detail::arena_ref _arena;
+    const char* _progname {nullptr};
+    // Shadowed options are only marked when registering and dropped from the
+    // list lazily, that's why opts() const may have to compact it.
+    mutable std::vector<opt_base> _opts;
+    mutable std::size_t _shadowed {0};
+    const char* const* _argv {nullptr};
+    std::vector<detail::arg_run> _runs;
+    std::size_t _nargs {0};
+    mutable std::vector<detail::index_entry> _long_index;
+    mutable std::size_t _long_count {0};
+    /// By unsigned char, so names that fail the asserts in release builds stay in bounds.
+    detail::opt_base::opt_impl* _short_index[256] {};
+    std::vector<const char*> _expanded; ///< Expanded argv, or all arguments of a buffer.
+    std::vector<occurrence> _occurrences;
+    error_list _errors;
+    detail::constraint_set _constraints;
+    std::vector<detail::command> _commands;
+    std::vector<detail::index_entry> _command_index;
+    std::size_t _selected {0}; ///< Selected command + 1, 0 if there is none.
+    mutable detail::name_trie _trie; ///< Built on first use, empty if it's outdated.
+    mutable std::string _help; ///< Rendered help page, empty if it's outdated.
+    mutable std::size_t _help_width {0};
+};
+
+/// Splits a command line string into arguments, starting with the program
+/// name. Quoting rules are the same as in response files: arguments are
+/// separated by whitespace, can be quoted with ' or ", and a backslash
+/// escapes the next character outside of single quotes. Arguments are
+/// written into a single buffer owned by this object, and stay valid until
+/// it's destroyed or split() is called again.
+struct command_line
+{
+    command_line() {}
+    explicit command_line(const char* str) { split(str); }
+    command_line(const char* str, std::size_t len) { split(str, len); }
+
+    command_line(const command_line&) = delete;
+    command_line& operator=(const command_line&) = delete;
+
+    /// Splits str, replacing the results of the previous call.
+    void split(const char* str);
+    void split(const char* str, std::size_t len);
+
+    /// Number of arguments.
+    int argc() const { return static_cast<int>(_argv.size()) - 1; }
+
+    /// Arguments, terminated with nullptr.
+    const char* const* argv() const { return _argv.data(); }
+
+private:
+    std::vector<char> _buf;
+    std::vector<const char*> _argv {nullptr};
+};
+
+/// Expands response files in argv.
+/// Every "@path" argument is replaced by the arguments read from the file at
+/// path, which can refer to other response files. Arguments in the file are
+/// separated by whitespace, can be quoted with ' or ", and a backslash escapes
+/// the next character outside of single quotes. Files are memory mapped and
+/// split in place, so arguments point straight into the mapping and stay valid
+/// until this object is destroyed. Arguments that can't be opened as a file are
+/// kept as they are, just like arguments after "--".
+struct response_files
+{
+    /// Nesting limit, deeper "@path" arguments are kept as they are.
+    static constexpr int max_depth = 16;
+
+    response_files() {}
+    response_files(int argc, const char* const* argv) { expand(argc, argv); }
+
+    response_files(const response_files&) = delete;
+    response_files& operator=(const response_files&) = delete;
+    ~response_files();
+
+    /// Expands argv, replacing the results of the previous call.
+    void expand(int argc, const char* const* argv);
+
+    /// Number of expanded arguments.
+    int argc() const { return static_cast<int>(_argv.size()) - 1; }
+
+    /// Expanded arguments, terminated with nullptr.
+    const char* const* argv() const { return _argv.data(); }
+
+private:
+    std::vector<detail::file_buffer> _files;
+    std::vector<const char*> _argv;
+};
+
+/// Parse results of a single schema::parse call.
+/// Results are looked up with option handles returned by the parser that
+/// the schema was compiled from. The same object can be passed to parse
+/// again, to reuse its memory.
+struct result
+{
+    result() {}
+
+    /// True if option was present in arguments.
+    bool is_set(const detail::opt_base& o) const noexcept;
+
+    /// Number of times option was present in arguments.
+    std::size_t count(const detail::opt_base& o) const noexcept;
+
+    /// Position of the last occurrence of option in arguments.
+    argparse::position position(const detail::opt_base& o) const noexcept;
+
+    /// Option value.
+    /// Returns fallback value if option was not set.
+    const char* value(const detail::param_t& o, const char* fallback = nullptr) const noexcept;
+
+    /// Converted option value.
+    /// Returns fallback value if option was not set.
+    std::int64_t value(const detail::int_param_t& o, std::int64_t fallback = 0) const noexcept;
+    double value(const detail::float_param_t& o, double fallback = 0) const noexcept;
+    std::chrono::nanoseconds value(const detail::duration_param_t& o,
+            std::chrono::nanoseconds fallback = std::chrono::nanoseconds{0}) const noexcept;
+    std::uint64_t value(const detail::bytes_param_t& o, std::uint64_t fallback = 0) const noexcept;
+
+    /// Values of a list param.
+    list_view values(const detail::list_param_t& o) const noexcept;
+
+    /// Option value. Same as is_set().
+    bool value(const detail::flag_t& o) const noexcept { return is_set(o); }
+
+    /// Option value. Same as count().
+    std::size_t value(const detail::counter_t& o) const noexcept { return count(o); }
+
+    /// Returns program name, argv[0].
+    const char* progname() const { return _progname; }
+
+    /// List of arguments.
+    args_view args() const
+    {
+        return args_view(_argv != nullptr ? _argv : _args.data(), _runs.data(), _runs.size(), _nargs);
+    }
+
+    /// Every occurrence of an option, in order of appearance.
+    const std::vector<occurrence>& occurrences() const { return _occurrences; }
+
+    /// Errors collected with the collect_errors flag.
+    const error_list& errors() const { return _errors; }
 
 private:
+    const detail::opt_slot* _find(const detail::opt_base& o) const noexcept;
+
+private:
+    const detail::opt_arena* _owner {nullptr};
     const char* _progname {nullptr};
-    std::vector<opt_base> _opts;
-    std::vector<const char*> _args;
+    std::vector<detail::opt_slot> _slots;
+    /// Argv that runs index into, or nullptr if they index into _args,
+    /// so copies of the result don't point into the original.
+    const char* const* _argv {nullptr};
+    std::vector<detail::arg_run> _runs;
+    std::size_t _nargs {0};
+    std::vector<const char*> _args; ///< All arguments of a buffer, like argv.
+    detail::list_store _lists;
+    std::vector<occurrence> _occurrences;
+    error_list _errors;
+    friend struct schema;
+};
+
+/// Parse results of schema::parse_batch.
+/// Stored as a structure of arrays: errors, program names and offsets are
+/// contiguous arrays with one entry per argument list. Options that were set
+/// and positional arguments are packed into one segment per worker thread,
+/// which keeps every field of the options in an array of its own.
+struct batch_result
+{
+    batch_result() {}
+
+    /// Number of parsed argument lists.
+    std::size_t size() const { return _errors.size(); }
+
+    /// Parse errors, one for every argument list.
+    const std::vector<error>& errors() const { return _errors; }
+
+    /// True if option was present in argument list i.
+    bool is_set(std::size_t i, const detail::opt_base& o) const noexcept;
+
+    /// Number of times option was present in argument list i.
+    std::size_t count(std::size_t i, const detail::opt_base& o) const noexcept;
+
+    /// Position of the last occurrence of option in argument list i.
+    argparse::position position(std::size_t i, const detail::opt_base& o) const noexcept;
+
+    /// Option value in argument list i.
+    /// Returns fallback value if option was not set.
+    const char* value(std::size_t i, const detail::param_t& o, const char* fallback = nullptr) const noexcept;
+
+    /// Converted option value in argument list i.
+    /// Returns fallback value if option was not set.
+    std::int64_t value(std::size_t i, const detail::int_param_t& o, std::int64_t fallback = 0) const noexcept;
+    double value(std::size_t i, const detail::float_param_t& o, double fallback = 0) const noexcept;
+    std::chrono::nanoseconds value(std::size_t i, const detail::duration_param_t& o,
+            std::chrono::nanoseconds fallback = std::chrono::nanoseconds{0}) const noexcept;
+    std::uint64_t value(std::size_t i, const detail::bytes_param_t& o, std::uint64_t fallback = 0) const noexcept;
+
+    /// Values of a list param in argument list i.
+    list_view values(std::size_t i, const detail::list_param_t& o) const noexcept;
+
+    /// Program name of argument list i, argv[0].
+    const char* progname(std::size_t i) const { return _argv[i][0]; }
+
+    /// Positional arguments of argument list i.
+    args_view args(std::size_t i) const;
+
+private:
+    /// Options that were set and runs of positional arguments of the
+    /// argument lists parsed by one worker, starting with list `first`.
+    struct segment
+    {
+        std::size_t first {0};
+        std::vector<std::uint32_t> ids;
+        std::vector<std::uint32_t> counts;
+        std::vector<argparse::position> positions;
+        std::vector<const char*> values;
+        std::vector<detail::opt_number> nums;
+        std::vector<detail::arg_run> runs;
+        detail::list_store lists;
+    };
+
+    const segment& _segment(std::size_t i) const noexcept;
+    /// Returns the segment and index of option o in argument list i, or
+    /// nullptr if it was not set.
+    const segment* _find(std::size_t i, const detail::opt_base& o, std::size_t& j) const noexcept;
+
+private:
+    const detail::opt_arena* _owner {nullptr};
+    std::vector<error> _errors;
+    std::vector<const char* const*> _argv;
+    std::vector<std::size_t> _nargs;
+    std::vector<std::size_t> _opts_end; ///< End of options of a list in its segment.
+    std::vector<std::size_t> _runs_end; ///< End of runs of a list in its segment.
+    std::vector<segment> _segments;
+    friend struct schema;
+};
+
+/// Immutable set of options, created by parser::compile().
+/// Cheap to copy. parse() doesn't modify the schema, so it can be called
+/// concurrently, as long as every thread uses its own result object.
+struct schema
+{
+    schema() {}
+
+    schema(const schema& b);
+    schema& operator=(const schema& b);
+    schema(schema&& b) noexcept;
+    schema& operator=(schema&& b) noexcept;
+    ~schema();
+
+    /// Parses argv into r. flags is a combination of parse_flags.
+    /// Can throw exception on unexpected conditions, like invalid argc/argv.
+    error parse(int argc, const char* const* argv, result& r, unsigned flags = 0) const;
+
+    /// Parses a buffer of NUL terminated arguments into r.
+    /// See parser::parse(const char*, std::size_t, unsigned).
+    error parse(const char* buf, std::size_t len, result& r, unsigned flags = 0) const;
+
+    /// Parses n argument lists, argcs[i] and argvs[i], into r.
+    /// Work is split between up to `threads` threads, including the calling
+    /// one. 0 picks the number of hardware threads.
+    /// Can throw exception on unexpected conditions, like invalid argc/argv.
+    void parse_batch(std::size_t n, const int* argcs, const char* const* const* argvs,
+            batch_result& r, unsigned threads = 0, unsigned flags = 0) const;
+
+private:
+    struct schema_impl;
+    const schema_impl& _impl() const;
+
+private:
+    schema_impl* _ptr {nullptr};
+    friend struct parser;
+};
+
+namespace detail {
+
+template <std::size_t... I>
+struct index_seq {};
+
+template <std::size_t N, std::size_t... I>
+struct make_index_seq : make_index_seq<N - 1, N - 1, I...> {};
+
+template <std::size_t... I>
+struct make_index_seq<0, I...> { using type = index_seq<I...>; };
+
+constexpr std::size_t static_strlen(const char* s)
+{
+    return s == nullptr || *s == '\0' ? 0 : 1 + static_strlen(s + 1);
+}
+
+/// Same FNV-1a hash as the one used by the runtime parser index.
+constexpr std::uint32_t static_hash(const char* s, std::size_t len, std::uint32_t h = 2166136261u)
+{
+    return len == 0 ? h : static_hash(s + 1, len - 1,
+            (h ^ static_cast<unsigned char>(*s)) * 16777619u);
+}
+
+constexpr std::uint64_t static_hist_add(std::uint64_t h, unsigned shift)
+{
+    return ((h >> shift) & 15) == 15 ? h : h + (std::uint64_t(1) << shift);
+}
+
+/// Same character histogram as the one used by the runtime parser.
+constexpr std::uint64_t static_hist(const char* s, std::size_t len, std::uint64_t h = 0)
+{
+    return len == 0 ? h : static_hist(s + 1, len - 1,
+            static_hist_add(h, (static_cast<unsigned char>(*s) & 15) * 4));
+}
+
+constexpr bool static_valid_short(char c)
+{
+    return c == 0 || (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+constexpr opt_spec static_spec(opt_type type, names_t names)
+{
+    return names.shortname == 0 && names.longname == nullptr
+        ? throw std::logic_error("either short or long name has to be set")
+        : !static_valid_short(names.shortname)
+        ? throw std::logic_error("short name has to match [0-9A-Za-z]")
+        : opt_spec{type, names.shortname, names.longname, static_strlen(names.longname), value_kind::string, 0,
+                static_hist(names.longname, static_strlen(names.longname))};
+}
+
+constexpr std::uint16_t static_pick_short(std::uint16_t later, const opt_spec& o, char c, std::uint16_t i)
+{
+    return later != 0 ? later : o.shortname == c && c != 0 ? i + 1 : 0;
+}
+
+/// Position + 1 of the last option with short name c, 0 if there is none.
+constexpr std::uint16_t static_find_short(char, std::uint16_t)
+{
+    return 0;
+}
+
+template <typename... R>
+constexpr std::uint16_t static_find_short(char c, std::uint16_t i, const opt_spec& o, const R&... r)
+{
+    return static_pick_short(static_find_short(c, i + 1, r...), o, c, i);
+}
+
+/// Type erased static_parser tables, passed to the parser implementation.
+struct static_view
+{
+    const opt_spec* opts;
+    const std::uint32_t* hashes;
+    const std::uint16_t* short_index;
+    std::size_t size;
+};
+
+error static_parse(const static_view& view, opt_slot* slots,
+        arg_run* runs, std::size_t max_runs, std::size_t& nruns, std::size_t& nargs,
+        error_list& errors, int argc, const char* const* argv, unsigned flags);
+
+} // namespace detail
+
+/// Declares a flag option for make_static_parser().
+/// Either short or long name has to be set.
+/// Short name has to match [0-9A-Za-z].
+constexpr detail::opt_spec static_flag(detail::names_t names)
+{
+    return detail::static_spec(detail::opt_type::flag, names);
+}
+
+/// Declares a parameter option for make_static_parser().
+/// Either short or long name has to be set.
+/// Short name has to match [0-9A-Za-z].
+constexpr detail::opt_spec static_param(detail::names_t names)
+{
+    return detail::static_spec(detail::opt_type::param, names);
+}
+
+/// Parse results of a static_parser with N options.
+/// Positional arguments are kept as a fixed array of MaxRuns runs of
+/// consecutive arguments in argv.
+template <std::size_t N, std::size_t MaxRuns = 16>
+struct static_result
+{
+    /// True if option number i was present in arguments.
+    bool is_set(std::size_t i) const noexcept { return _slots[i].count != 0; }
+
+    /// Number of times option number i was present in arguments.
+    std::size_t count(std::size_t i) const noexcept { return _slots[i].count; }
+
+    /// Position of the last occurrence of option number i in arguments.
+    argparse::position position(std::size_t i) const noexcept { return _slots[i].pos; }
+
+    /// Value of parameter number i.
+    /// Returns fallback value if option was not set.
+    const char* value(std::size_t i, const char* fallback = nullptr) const noexcept
+    {
+        return _slots[i].value != nullptr ? _slots[i].value : fallback;
+    }
+
+    /// Returns program name, argv[0].
+    const char* progname() const noexcept { return _argv != nullptr ? _argv[0] : nullptr; }
+
+    /// Positional arguments.
+    args_view args() const noexcept { return args_view(_argv, _runs, _nruns, _nargs); }
+
+    /// Errors collected with the collect_errors flag.
+    const error_list& errors() const noexcept { return _errors; }
+
+private:
+    detail::opt_slot _slots[N];
+    detail::arg_run _runs[MaxRuns];
+    std::size_t _nruns {0};
+    std::size_t _nargs {0};
+    const char* const* _argv {nullptr};
+    error_list _errors;
+
+    template <std::size_t>
+    friend struct static_parser;
 };
 
+/// Parser for a set of options fixed at compile time.
+/// Names and lookup tables are computed by the compiler, and parsing writes
+/// into a static_result, so there are no heap allocations.
+/// Like with parser, options declared later shadow earlier ones.
+template <std::size_t N>
+struct static_parser
+{
+    static_assert(N > 0, "static_parser needs at least one option");
+    static_assert(N < 65535, "too many options");
+
+    template <typename... S>
+    constexpr explicit static_parser(const S&... opts)
+        : static_parser(typename detail::make_index_seq<128>::type{}, opts...) {}
+
+    /// Parses argv into r. flags is a combination of parse_flags.
+    /// Can throw exception on invalid argc/argv, just like parser::parse.
+    /// Returns error::too_many_arguments if positional arguments don't fit in r.
+    template <std::size_t MaxRuns>
+    error parse(int argc, const char* const* argv, static_result<N, MaxRuns>& r, unsigned flags = 0) const
+    {
+        detail::static_view view {_opts, _hashes, _short, N};
+        for (auto& s : r._slots)
+            s = detail::opt_slot{};
+        error res = detail::static_parse(view, r._slots, r._runs, MaxRuns, r._nruns, r._nargs,
+                r._errors, argc, argv, flags);
+        r._argv = argv;
+        return res;
+    }
+
+    /// Option declaration number i.
+    constexpr const detail::opt_spec& opt(std::size_t i) const { return _opts[i]; }
+
+    /// Number of options.
+    static constexpr std::size_t size() { return N; }
+
+private:
+    template <std::size_t... I, typename... S>
+    constexpr static_parser(detail::index_seq<I...>, const S&... opts)
+        : _opts{opts...}
+        , _hashes{detail::static_hash(opts.longname, opts.longlen)...}
+        , _short{detail::static_find_short(static_cast<char>(I), 0, opts...)...} {}
+
+    detail::opt_spec _opts[N];
+    std::uint32_t _hashes[N];
+    std::uint16_t _short[128];
+};
+
+/// Creates a static_parser, eg.
+///   constexpr auto p = argparse::make_static_parser(
+///       argparse::static_flag({'v', "verbose"}),
+///       argparse::static_param({'o', "output"}));
+template <typename... S>
+constexpr static_parser<sizeof...(S)> make_static_parser(const S&... opts)
+{
+    return static_parser<sizeof...(S)>(opts...);
+}
+
 } // namespace argparse
 
 #endif // ARGPARSE_HPP
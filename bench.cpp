@@ -0,0 +1,612 @@
+// Argument parsing library
+// License: UNLICENSE <https://www.unlicense.org>
+// Website: https://github.com/ii14/argparse
+
+#include "argparse.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+// Baseline for the command line tokenizer: argparse.cpp built again with
+// ARGPARSE_NO_SIMD, in its own namespace so both can be linked together.
+// See build/bench in the Makefile.
+#undef ARGPARSE_HPP
+#define argparse argparse_no_simd
+#include "argparse.hpp"
+#undef argparse
+
+using bench_clock = std::chrono::steady_clock;
+
+static double elapsed_us(bench_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(bench_clock::now() - start).count();
+}
+
+/// Generates n distinct long names, "opt-0" ... "opt-<n-1>".
+static std::vector<std::string> make_names(std::size_t n)
+{
+    std::vector<std::string> names;
+    names.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        names.push_back("opt-" + std::to_string(i));
+    return names;
+}
+
+/// Command line with `count` long options spread evenly over the registered ones.
+static std::vector<std::string> make_args(const std::vector<std::string>& names, std::size_t count)
+{
+    std::vector<std::string> args;
+    args.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+        args.push_back("--" + names[(i * 7919) % names.size()]);
+    return args;
+}
+
+// long option lookup
+
+static void bench_long_lookup()
+{
+    const std::size_t nargs = 1000;
+    const int rounds = 20;
+
+    std::printf("long option lookup, %zu arguments per parse\n", nargs);
+    std::printf("%10s %14s %14s %10s\n", "options", "linear (us)", "indexed (us)", "speedup");
+
+    for (std::size_t nopts : {10, 100, 1000, 10000}) {
+        auto names = make_names(nopts);
+        auto args = make_args(names, nargs);
+        std::vector<const char*> argv {"prog"};
+        for (const auto& a : args)
+            argv.push_back(a.c_str());
+
+        double linear = 0, indexed = 0;
+        std::size_t found = 0;
+        for (int r = 0; r < rounds; ++r) {
+            argparse::parser p;
+            for (const auto& n : names)
+                p.flag(n.c_str());
+
+            // Baseline: what lookup_long used to do, a strcmp against every option.
+            auto start = bench_clock::now();
+            for (std::size_t i = 1; i < argv.size(); ++i) {
+                for (const auto& o : p.opts()) {
+                    if (o.longname() != nullptr && std::strcmp(o.longname(), &argv[i][2]) == 0) {
+                        ++found;
+                        break;
+                    }
+                }
+            }
+            linear += elapsed_us(start);
+
+            start = bench_clock::now();
+            if (!p.parse(argv.size(), argv.data()))
+                std::printf("unexpected parse error\n");
+            indexed += elapsed_us(start);
+        }
+
+        if (found != nargs * rounds)
+            std::printf("unexpected lookup miss\n");
+        std::printf("%10zu %14.1f %14.1f %9.1fx\n", nopts,
+                linear / rounds, indexed / rounds, linear / indexed);
+    }
+}
+
+// option registration
+
+static void bench_registration()
+{
+    const int rounds = 5;
+
+    std::printf("option registration\n");
+    std::printf("%10s %14s %14s %10s\n", "options", "linear (us)", "indexed (us)", "speedup");
+
+    for (std::size_t nopts : {1000, 10000}) {
+        auto names = make_names(nopts);
+
+        double linear = 0, indexed = 0;
+        std::size_t dups = 0;
+        for (int r = 0; r < rounds; ++r) {
+            // Baseline: the two scans _remove_duplicates used to run before every registration.
+            argparse::parser b;
+            auto start = bench_clock::now();
+            for (const auto& n : names) {
+                for (const auto& o : b.opts())
+                    if (o.shortname() == 'x')
+                        ++dups;
+                for (const auto& o : b.opts())
+                    if (o.longname() != nullptr && std::strcmp(o.longname(), n.c_str()) == 0)
+                        ++dups;
+                b.flag(n.c_str());
+            }
+            linear += elapsed_us(start);
+
+            start = bench_clock::now();
+            argparse::parser p;
+            for (const auto& n : names)
+                p.flag(n.c_str());
+            indexed += elapsed_us(start);
+        }
+
+        if (dups != 0)
+            std::printf("unexpected duplicate\n");
+        std::printf("%10zu %14.1f %14.1f %9.1fx\n", nopts,
+                linear / rounds, indexed / rounds, linear / indexed);
+    }
+}
+
+// batch parsing
+
+static void bench_batch()
+{
+    const std::size_t nlines = 200000;
+
+    argparse::parser p;
+    auto names = make_names(100);
+    std::vector<argparse::parser::flag_t> flags; // Indexed by option id.
+    for (const auto& n : names)
+        flags.push_back(p.flag(n.c_str()));
+    auto s = p.compile();
+
+    auto args = make_args(names, 16);
+    std::vector<const char*> line {"prog"};
+    for (const auto& a : args)
+        line.push_back(a.c_str());
+    line.push_back("file");
+    std::vector<int> argcs(nlines, line.size());
+    std::vector<const char* const*> argvs(nlines, line.data());
+
+    std::printf("batch parsing, %zu lines of %zu arguments\n", nlines, line.size());
+    std::printf("%10s %14s %12s\n", "threads", "time (ms)", "lines/s");
+
+    // Reference point: a parse() loop that keeps what batch results keep,
+    // the error and every option that was set.
+    struct kept
+    {
+        std::uint32_t id;
+        std::uint32_t count;
+        argparse::position pos;
+    };
+    std::vector<argparse::error> errors;
+    std::vector<std::size_t> offsets;
+    std::vector<kept> opts;
+    argparse::result r;
+    auto start = bench_clock::now();
+    errors.reserve(nlines);
+    offsets.reserve(nlines);
+    for (std::size_t i = 0; i < nlines; ++i) {
+        errors.push_back(s.parse(argcs[i], argvs[i], r));
+        for (const auto& o : r.occurrences()) {
+            // Once per option, at its last occurrence.
+            if (r.position(flags[o.id]) == o.pos)
+                opts.push_back(kept{o.id, static_cast<std::uint32_t>(r.count(flags[o.id])), o.pos});
+        }
+        offsets.push_back(opts.size());
+    }
+    double serial = elapsed_us(start) / 1000;
+    std::printf("%10s %14.1f %12.0f\n", "loop", serial, nlines / serial * 1000);
+
+    unsigned hw = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned threads = 1; threads <= hw; threads *= 2) {
+        argparse::batch_result br;
+        start = bench_clock::now();
+        s.parse_batch(nlines, argcs.data(), argvs.data(), br, threads);
+        double ms = elapsed_us(start) / 1000;
+        std::printf("%10u %14.1f %12.0f\n", threads, ms, nlines / ms * 1000);
+    }
+}
+
+// command line tokenizer
+
+static void bench_tokenizer()
+{
+    const int rounds = 200;
+
+    std::printf("command line tokenizer\n");
+    std::printf("%10s %10s %14s %14s %10s\n", "arguments", "bytes", "scalar (us)", "bulk (us)", "speedup");
+
+    for (std::size_t nargs : {10, 100, 1000, 10000}) {
+        // Mostly long plain paths and values, with some quoting mixed in.
+        std::string str = "prog";
+        for (std::size_t i = 0; i < nargs; ++i) {
+            switch (i % 4) {
+            case 0: str += " --include-directory=/usr/local/include/project-" + std::to_string(i); break;
+            case 1: str += " \"/home/user/My Documents/source file " + std::to_string(i) + ".cpp\""; break;
+            case 2: str += " -DVALUE_" + std::to_string(i) + "='some quoted value'"; break;
+            case 3: str += " /var/lib/build/objects/very/deep/directory/structure/" + std::to_string(i) + ".o"; break;
+            }
+        }
+
+        argparse_no_simd::command_line out;
+        auto start = bench_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            out.split(str.data(), str.size());
+        double scalar = elapsed_us(start);
+
+        argparse::command_line cl;
+        start = bench_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            cl.split(str.data(), str.size());
+        double bulk = elapsed_us(start);
+
+        if (out.argc() != cl.argc() || static_cast<std::size_t>(cl.argc()) != nargs + 1)
+            std::printf("unexpected argument count\n");
+        std::printf("%10zu %10zu %14.1f %14.1f %9.1fx\n", nargs, str.size(),
+                scalar / rounds, bulk / rounds, scalar / bulk);
+    }
+}
+
+// "did you mean" suggestions
+
+/// Baseline: Levenshtein distance with the full dynamic programming table.
+static std::size_t edit_distance(const char* a, std::size_t n, const char* b, std::size_t m)
+{
+    std::vector<std::size_t> d((n + 1) * (m + 1));
+    for (std::size_t i = 0; i <= n; ++i)
+        d[i * (m + 1)] = i;
+    for (std::size_t j = 0; j <= m; ++j)
+        d[j] = j;
+    for (std::size_t i = 1; i <= n; ++i)
+        for (std::size_t j = 1; j <= m; ++j)
+            d[i * (m + 1) + j] = std::min({
+                d[(i - 1) * (m + 1) + j] + 1,
+                d[i * (m + 1) + j - 1] + 1,
+                d[(i - 1) * (m + 1) + j - 1] + (a[i - 1] != b[j - 1])});
+    return d[n * (m + 1) + m];
+}
+
+static void bench_suggest()
+{
+    const int rounds = 200;
+
+    std::printf("unknown option suggestions\n");
+    std::printf("%10s %14s %14s %10s\n", "options", "naive (us)", "pruned (us)", "speedup");
+
+    for (std::size_t nopts : {100, 1000, 10000}) {
+        // Realistic looking names, so that length and histogram pruning
+        // don't get an unfair advantage from uniform "opt-N" names.
+        static const char* const words[] = {
+            "enable", "disable", "max", "min", "output", "input", "cache",
+            "thread", "log", "level", "format", "directory", "timeout", "retry",
+        };
+        std::vector<std::string> names;
+        names.reserve(nopts);
+        for (std::size_t i = 0; i < nopts; ++i)
+            names.push_back(std::string(words[i % 14]) + "-" + words[(i / 14) % 14] + "-" + std::to_string(i));
+        const std::string typo = "--" + names[nopts / 2].substr(1);
+        const char* argv[] = {"prog", typo.c_str()};
+
+        argparse::parser p;
+        for (const auto& n : names)
+            p.flag(n.c_str());
+        auto s = p.compile();
+        argparse::result r;
+
+        const char* naive_best = nullptr;
+        auto start = bench_clock::now();
+        for (int i = 0; i < rounds; ++i) {
+            std::size_t best = static_cast<std::size_t>(-1);
+            for (const auto& o : p.opts()) {
+                std::size_t d = edit_distance(&typo[2], typo.size() - 2, o.longname(), std::strlen(o.longname()));
+                if (d < best) {
+                    best = d;
+                    naive_best = o.longname();
+                }
+            }
+        }
+        double naive = elapsed_us(start);
+
+        const char* pruned_best = nullptr;
+        start = bench_clock::now();
+        for (int i = 0; i < rounds; ++i)
+            pruned_best = s.parse(2, argv, r).suggestion();
+        double pruned = elapsed_us(start);
+
+        if (pruned_best == nullptr || naive_best == nullptr || std::strcmp(pruned_best, naive_best) != 0)
+            std::printf("unexpected suggestion\n");
+        std::printf("%10zu %14.1f %14.1f %9.1fx\n", nopts,
+                naive / rounds, pruned / rounds, naive / pruned);
+    }
+}
+
+// help page
+
+/// Baseline: an ad-hoc renderer with iostreams and no wrapping.
+static std::string help_iostream(const argparse::parser& p)
+{
+    std::ostringstream ss;
+    for (const auto& o : p.opts()) {
+        std::ostringstream names;
+        if (o.shortname() != 0)
+            names << '-' << o.shortname() << (o.longname() != nullptr ? ", " : "");
+        else
+            names << "    ";
+        if (o.longname() != nullptr)
+            names << "--" << o.longname();
+        if (o.metavar() != nullptr)
+            names << ' ' << o.metavar();
+        ss << "  " << std::left << std::setw(30) << names.str()
+           << (o.description() != nullptr ? o.description() : "") << '\n';
+    }
+    return ss.str();
+}
+
+static void bench_help()
+{
+    const std::size_t nopts = 1500;
+    const int rounds = 20;
+
+    auto names = make_names(nopts);
+    argparse::parser p;
+    for (std::size_t i = 0; i < nopts; ++i) {
+        if (i % 100 == 0)
+            p.category("Category");
+        if (i % 2 == 0)
+            p.flag(names[i].c_str(), "Enables the thing this option is named after, with a fairly long description that has to wrap.");
+        else
+            p.param(names[i].c_str(), "Sets the value of the thing.", "VALUE");
+    }
+
+    std::printf("help page, %zu options\n", nopts);
+    std::printf("%14s %14s %14s\n", "iostream (us)", "render (us)", "cached (us)");
+
+    std::size_t size = 0;
+    auto start = bench_clock::now();
+    for (int i = 0; i < rounds; ++i)
+        size += help_iostream(p).size();
+    double iostream = elapsed_us(start) / rounds;
+
+    start = bench_clock::now();
+    size += p.help().size();
+    double render = elapsed_us(start);
+
+    start = bench_clock::now();
+    for (int i = 0; i < rounds; ++i)
+        size += p.help().size();
+    double cached = elapsed_us(start) / rounds;
+
+    if (size == 0)
+        std::printf("unexpected empty page\n");
+    std::printf("%14.1f %14.1f %14.3f\n", iostream, render, cached);
+}
+
+// subcommands
+
+static void bench_subcommands()
+{
+    const std::size_t ncommands = 200, nopts = 50;
+    const int rounds = 20;
+
+    auto commands = make_names(ncommands);
+    auto names = make_names(nopts);
+    const char* argv[] = {"prog", commands[ncommands / 2].c_str(), "--opt-7"};
+
+    std::printf("subcommands, %zu commands with %zu options each\n", ncommands, nopts);
+    std::printf("%14s %14s %10s\n", "eager (us)", "lazy (us)", "speedup");
+
+    // Baseline: every command gets its parser up front, then the first
+    // argument picks one of them.
+    auto start = bench_clock::now();
+    std::size_t found = 0;
+    for (int r = 0; r < rounds; ++r) {
+        std::vector<argparse::parser> parsers(ncommands);
+        for (auto& sub : parsers)
+            for (const auto& n : names)
+                sub.flag(n.c_str());
+        for (std::size_t i = 0; i < ncommands; ++i) {
+            if (commands[i] == argv[1]) {
+                found += parsers[i].parse(2, argv + 1) == true;
+                break;
+            }
+        }
+    }
+    double eager = elapsed_us(start);
+
+    start = bench_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        argparse::parser p;
+        for (const auto& c : commands) {
+            p.command(c.c_str(), [&names](argparse::parser& sub) {
+                for (const auto& n : names)
+                    sub.flag(n.c_str());
+            });
+        }
+        found += p.parse(3, argv) == true;
+    }
+    double lazy = elapsed_us(start);
+
+    if (found != 2 * rounds)
+        std::printf("unexpected parse error\n");
+    std::printf("%14.1f %14.1f %9.1fx\n", eager / rounds, lazy / rounds, eager / lazy);
+}
+
+// completion
+
+static void bench_complete()
+{
+    const int rounds = 1000;
+
+    std::printf("completion of \"--opt-12\"\n");
+    std::printf("%10s %14s %14s %14s %10s\n", "options", "scan (us)", "build (us)", "query (us)", "matches");
+
+    for (std::size_t nopts : {1000, 10000}) {
+        auto names = make_names(nopts);
+        argparse::parser p;
+        for (const auto& n : names)
+            p.flag(n.c_str());
+        const char* argv[] = {"prog", "--opt-12"};
+        std::vector<const char*> out;
+
+        // Baseline: a prefix comparison against every option.
+        std::size_t scanned = 0;
+        auto start = bench_clock::now();
+        for (int r = 0; r < rounds; ++r)
+            for (const auto& o : p.opts())
+                scanned += std::strncmp(o.longname(), "opt-12", 6) == 0;
+        double scan = elapsed_us(start) / rounds;
+
+        // The first query builds the trie.
+        start = bench_clock::now();
+        std::size_t n = p.complete(2, argv, out);
+        double build = elapsed_us(start);
+
+        start = bench_clock::now();
+        for (int r = 0; r < rounds; ++r) {
+            out.clear();
+            p.complete(2, argv, out);
+        }
+        double query = elapsed_us(start) / rounds;
+
+        if (n != out.size() || scanned != n * rounds)
+            std::printf("unexpected completions\n");
+        std::printf("%10zu %14.2f %14.1f %14.2f %10zu\n", nopts, scan, build, query, n);
+    }
+}
+
+// long option abbreviations
+
+static void bench_abbreviations()
+{
+    const std::size_t nargs = 1000;
+    const int rounds = 5;
+
+    std::printf("abbreviated long options, %zu arguments per parse\n", nargs);
+    std::printf("%10s %14s %14s %10s\n", "options", "linear (us)", "trie (us)", "speedup");
+
+    for (std::size_t nopts : {100, 1000, 10000}) {
+        std::vector<std::string> names, args;
+        names.reserve(nopts);
+        for (std::size_t i = 0; i < nopts; ++i)
+            names.push_back("opt-" + std::to_string(i) + "-long");
+        for (std::size_t i = 0; i < nargs; ++i)
+            args.push_back("--opt-" + std::to_string((i * 7919) % nopts) + "-l");
+        std::vector<const char*> argv {"prog"};
+        for (const auto& a : args)
+            argv.push_back(a.c_str());
+
+        double linear = 0, trie = 0;
+        std::size_t found = 0;
+        for (int r = 0; r < rounds; ++r) {
+            argparse::parser p;
+            for (const auto& n : names)
+                p.flag(n.c_str());
+
+            // Baseline: a prefix comparison against every option, counting
+            // matches to detect ambiguity.
+            auto start = bench_clock::now();
+            for (std::size_t i = 1; i < argv.size(); ++i) {
+                const char* arg = &argv[i][2];
+                const std::size_t len = std::strlen(arg);
+                std::size_t matches = 0;
+                for (const auto& o : p.opts())
+                    matches += std::strncmp(o.longname(), arg, len) == 0;
+                found += matches == 1;
+            }
+            linear += elapsed_us(start);
+
+            // Includes building the trie on the first lookup.
+            start = bench_clock::now();
+            if (!p.parse(argv.size(), argv.data(), argparse::allow_abbreviations))
+                std::printf("unexpected parse error\n");
+            trie += elapsed_us(start);
+        }
+
+        if (found != nargs * rounds)
+            std::printf("unexpected ambiguity\n");
+        std::printf("%10zu %14.1f %14.1f %9.1fx\n", nopts,
+                linear / rounds, trie / rounds, linear / trie);
+    }
+}
+
+static void bench_constraints()
+{
+    const int nparses = 10000;
+    const std::size_t group = 16;
+
+    std::printf("exactly one of every %zu options, %d parses\n", group, nparses);
+    std::printf("%10s %14s %14s %10s\n", "options", "loops (us)", "bitmask (us)", "speedup");
+
+    for (std::size_t nopts : {64, 256, 1024}) {
+        std::vector<std::string> names;
+        names.reserve(nopts);
+        for (std::size_t i = 0; i < nopts; ++i)
+            names.push_back("opt-" + std::to_string(i));
+
+        argparse::parser plain, constrained;
+        for (const auto& n : names) {
+            plain.flag(n.c_str());
+            constrained.flag(n.c_str());
+        }
+        const auto& opts = constrained.opts();
+        for (std::size_t i = 0; i < nopts; i += group) {
+            constrained.exactly_one({opts[i], opts[i + 1], opts[i + 2], opts[i + 3],
+                opts[i + 4], opts[i + 5], opts[i + 6], opts[i + 7],
+                opts[i + 8], opts[i + 9], opts[i + 10], opts[i + 11],
+                opts[i + 12], opts[i + 13], opts[i + 14], opts[i + 15]});
+        }
+        auto s1 = plain.compile();
+        auto s2 = constrained.compile();
+
+        std::vector<std::string> args;
+        args.reserve(nopts / group);
+        std::vector<const char*> argv {"prog"};
+        for (std::size_t i = 0; i < nopts; i += group) {
+            args.push_back("--" + names[i + i / group % group]);
+            argv.push_back(args.back().c_str());
+        }
+
+        // Baseline: parse, then count the options of every group by hand.
+        argparse::result r;
+        std::size_t violations = 0;
+        auto start = bench_clock::now();
+        for (int i = 0; i < nparses; ++i) {
+            s1.parse(argv.size(), argv.data(), r);
+            for (std::size_t g = 0; g < nopts; g += group) {
+                std::size_t count = 0;
+                for (std::size_t o = g; o < g + group; ++o)
+                    count += r.is_set(plain.opts()[o]);
+                violations += count != 1;
+            }
+        }
+        const double loops = elapsed_us(start);
+
+        start = bench_clock::now();
+        for (int i = 0; i < nparses; ++i)
+            violations += !s2.parse(argv.size(), argv.data(), r);
+        const double bitmask = elapsed_us(start);
+
+        if (violations != 0)
+            std::printf("unexpected violation\n");
+        std::printf("%10zu %14.1f %14.1f %9.1fx\n", nopts, loops, bitmask, loops / bitmask);
+    }
+}
+
+int main()
+{
+    bench_long_lookup();
+    std::printf("\n");
+    bench_registration();
+    std::printf("\n");
+    bench_batch();
+    std::printf("\n");
+    bench_tokenizer();
+    std::printf("\n");
+    bench_suggest();
+    std::printf("\n");
+    bench_help();
+    std::printf("\n");
+    bench_subcommands();
+    std::printf("\n");
+    bench_complete();
+    std::printf("\n");
+    bench_abbreviations();
+    std::printf("\n");
+    bench_constraints();
+    return 0;
+}
@@ -4,6 +4,13 @@
 
 #include "test.hpp"
 
+#include <cstdlib>
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
 int main() { return test_case_registry::run(); }
 
 using err_t = argparse::error;
@@ -260,6 +267,28 @@ TEST_CASE {
     error = err_t();
 }
 
+// params long name with value after '='
+
+TEST_CASE {
+    argv = {"prog", "--opt-b=def", "--opt-a=", "x"};
+    opts = {
+        new test_param(0, "opt-a", "A", ""),
+        new test_param(0, "opt-b", "B", "def"),
+    };
+    args = {"x"};
+    error = err_t();
+}
+
+TEST_CASE {
+    argv = {"prog", "--opt-a=b=c", "--opt-b", "--opt-a=d"};
+    opts = {
+        new test_param(0, "opt-a", "A", "b=c"),
+        new test_param(0, "opt-b", "B", "--opt-a=d"),
+    };
+    args = {};
+    error = err_t();
+}
+
 // missing argument error
 
 TEST_CASE {
@@ -351,6 +380,92 @@ TEST_CASE {
     error = err_t();
 }
 
+TEST_CASE {
+    argv = {"prog", "-ab"};
+    opts = {
+        new test_flag('a', "opt-a", "A1", false),
+        new test_flag('b', nullptr, "B", true),
+        new test_flag('a', nullptr, "A2", true),
+    };
+    args = {};
+    error = err_t();
+}
+
+TEST {
+    // Enough long names to grow the index several times, with shadowing
+    // erasing entries and compacting the option list along the way.
+    const std::size_t n = 300;
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < n; ++i)
+        names.push_back("opt-" + std::to_string(i));
+
+    argparse::parser p;
+    std::vector<argparse::parser::flag_t> first, last;
+    for (std::size_t i = 0; i < n; ++i)
+        first.push_back(p.flag({i < 20 ? static_cast<char>('A' + i) : '\0', names[i].c_str()}));
+    last = first;
+    for (int round = 0; round < 2; ++round)
+        for (std::size_t i = 0; i < n; ++i)
+            if (i % 3 != 0)
+                last[i] = p.flag(names[i].c_str());
+
+    // Only the options that still have a name are left.
+    ASSERT(p.opts().size() == n + 13);
+
+    std::vector<std::string> argv_s {"prog", "-AB"};
+    for (std::size_t i = 0; i < n; ++i)
+        argv_s.push_back("--" + names[i]);
+    std::vector<const char*> argv;
+    for (const auto& a : argv_s)
+        argv.push_back(a.c_str());
+    ASSERT(p.parse(static_cast<int>(argv.size()), argv.data()) == true);
+
+    for (std::size_t i = 0; i < n; ++i) {
+        ASSERT(last[i].is_set());
+        if (i % 3 != 0)
+            ASSERT(first[i].is_set() == (i == 1));
+    }
+}
+
+// option handles
+
+TEST {
+    // Handles keep the records of their parser alive.
+    argparse::parser::flag_t a;
+    argparse::parser::param_t b;
+    argparse::parser::counter_t v;
+    argparse::parser::int_param_t n;
+    argparse::parser::list_param_t l;
+    argparse::schema s;
+    {
+        argparse::parser p;
+        a = p.flag('a');
+        b = p.param("opt-b");
+        v = p.counter('v');
+        n = p.int_param('n');
+        l = p.list_param('l', nullptr, ',');
+        p.flag('c');
+        const char* argv[] = {"prog", "-a", "--opt-b=x", "-vv", "-n", "42", "-l", "1,2", "-l", "3"};
+        ASSERT(p.parse(10, argv) == true);
+        s = p.compile();
+    }
+    ASSERT(a.is_set() && strcmp(*b, "x") == 0 && *v == 2 && *n == 42);
+    ASSERT(l.values().size() == 3 && strcmp(l.values()[2], "3") == 0);
+    ASSERT(strcmp(b.longname(), "opt-b") == 0 && a.shortname() == 'a');
+
+    // Copies made afterwards, and the last handle going away, are fine too.
+    auto b2 = b;
+    b = argparse::parser::param_t();
+    a = argparse::parser::flag_t();
+    ASSERT(strcmp(*b2, "x") == 0 && !a.is_set());
+
+    // So does a schema.
+    argparse::result r;
+    const char* argv[] = {"prog", "-n", "7"};
+    ASSERT(s.parse(3, argv, r) == true);
+    ASSERT(r.value(n) == 7 && !r.is_set(v));
+}
+
 // unknown option error
 
 TEST_CASE {
@@ -383,6 +498,33 @@ TEST_CASE {
     error = err_t(err_t::unknown_option, "--opt-a");
 }
 
+TEST_CASE {
+    argv = {"prog", "--opt-a=x"};
+    opts = {
+        new test_param(0, "opt-ab", "AB", nullptr),
+    };
+    args = {};
+    error = err_t(err_t::unknown_option, "--opt-a=x");
+}
+
+TEST_CASE {
+    argv = {"prog", "--opt-a=x"};
+    opts = {
+        new test_flag(0, "opt-a", "A", false),
+    };
+    args = {};
+    error = err_t(err_t::unexpected_argument, "--opt-a=x");
+}
+
+TEST_CASE {
+    argv = {"prog", "-a\xe1"};
+    opts = {
+        new test_flag('a', nullptr, "A", true),
+    };
+    args = {};
+    error = err_t(err_t::unknown_option, '\xe1');
+}
+
 // arguments
 
 TEST_CASE {
@@ -468,3 +610,1309 @@ TEST_CASE {
     args = {"-"};
     error = err_t();
 }
+
+// static parser
+
+static constexpr auto static_opts = argparse::make_static_parser(
+    argparse::static_flag({'a', "opt-a"}),
+    argparse::static_flag('b'),
+    argparse::static_param({'c', "opt-c"}),
+    argparse::static_flag({'a', "opt-d"}));
+
+static_assert(static_opts.size() == 4, "size");
+static_assert(static_opts.opt(0).longlen == 5, "long name length");
+static_assert(static_opts.opt(1).longname == nullptr, "no long name");
+
+TEST {
+    argparse::static_result<4> r;
+    const char* argv[] = {"prog", "x", "--opt-a", "-ba", "--opt-c", "val", "y", "--", "-c"};
+    auto res = static_opts.parse(9, argv, r);
+    ASSERT(res == true);
+    ASSERT(strcmp(r.progname(), "prog") == 0);
+    ASSERT(r.is_set(0));
+    ASSERT(r.is_set(1));
+    ASSERT(r.is_set(2));
+    ASSERT(r.is_set(3));
+    ASSERT(strcmp(r.value(2), "val") == 0);
+    ASSERT(r.args().size() == 3);
+    ASSERT(strcmp(r.args()[0], "x") == 0);
+    ASSERT(strcmp(r.args()[1], "y") == 0);
+    ASSERT(strcmp(r.args()[2], "-c") == 0);
+}
+
+TEST {
+    argparse::static_result<4> r;
+    const char* argv[] = {"prog", "-cb"};
+    auto res = static_opts.parse(2, argv, r);
+    ASSERT(res == false);
+    ASSERT(res.type() == err_t::missing_argument);
+    ASSERT(strcmp(res.optname(), "-c") == 0);
+    ASSERT(!r.is_set(0));
+    ASSERT(r.value(2, "fallback") == std::string("fallback"));
+}
+
+TEST {
+    argparse::static_result<4> r;
+    const char* argv[] = {"prog", "--opt-b"};
+    auto res = static_opts.parse(2, argv, r);
+    ASSERT(res == false);
+    ASSERT(res.type() == err_t::unknown_option);
+    ASSERT(strcmp(res.optname(), "--opt-b") == 0);
+}
+
+TEST {
+    argparse::static_result<4, 1> r;
+    const char* argv[] = {"prog", "x", "y", "-a", "z"};
+    auto res = static_opts.parse(5, argv, r);
+    ASSERT(res == false);
+    ASSERT(res.type() == err_t::too_many_arguments);
+    ASSERT(strcmp(res.optname(), "z") == 0);
+}
+
+// compiled schema
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag({'a', "opt-a"});
+    auto b = p.param({'b', "opt-b"});
+    p.category("other");
+    auto c = p.flag('c');
+    auto s = p.compile();
+
+    // options registered after compile() are not part of the schema
+    auto d = p.flag('d');
+    auto a2 = p.flag({'a', "opt-x"});
+
+    argparse::result r1, r2;
+    const char* argv1[] = {"prog", "-ab", "x", "y"};
+    const char* argv2[] = {"prog", "z", "--opt-b", "w", "-c"};
+    ASSERT(s.parse(4, argv1, r1) == true);
+    ASSERT(s.parse(5, argv2, r2) == true);
+
+    ASSERT(r1.is_set(a) && r1.value(a));
+    ASSERT(r1.is_set(b) && strcmp(r1.value(b), "x") == 0);
+    ASSERT(!r1.is_set(c));
+    ASSERT(r1.args().size() == 1 && strcmp(r1.args()[0], "y") == 0);
+
+    ASSERT(!r2.is_set(a));
+    ASSERT(strcmp(r2.value(b), "w") == 0);
+    ASSERT(r2.is_set(c));
+    ASSERT(r2.args().size() == 1 && strcmp(r2.args()[0], "z") == 0);
+
+    // the parser itself is untouched
+    ASSERT(!a.is_set() && !b.is_set() && !c.is_set());
+    ASSERT(!r1.is_set(a2) && !r1.is_set(d));
+
+    const char* argv3[] = {"prog", "-d"};
+    auto res = s.parse(2, argv3, r1);
+    ASSERT(res == false);
+    ASSERT(res.type() == err_t::unknown_option);
+    ASSERT(!r1.is_set(a) && !r1.is_set(b));
+
+    // handles from other parsers are never set
+    argparse::parser q;
+    auto qa = q.flag('a');
+    ASSERT(s.parse(4, argv1, r1) == true);
+    ASSERT(!r1.is_set(qa));
+    ASSERT(strcmp(r1.value(b, "fallback"), "x") == 0);
+}
+
+TEST {
+    argparse::schema s;
+    {
+        argparse::parser p;
+        p.flag('a');
+        s = p.compile();
+    }
+    argparse::result r;
+    const char* argv[] = {"prog", "-a", "x"};
+    ASSERT(s.parse(3, argv, r) == true);
+    ASSERT(r.args().size() == 1);
+
+    argparse::schema empty;
+    ASSERT(empty.parse(3, argv, r) == false);
+}
+
+// batch parsing
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto b = p.param('b');
+    auto s = p.compile();
+
+    std::vector<std::vector<const char*>> lines;
+    for (size_t i = 0; i < 1000; ++i) {
+        switch (i % 4) {
+        case 0: lines.push_back({"prog", "-a", "x"}); break;
+        case 1: lines.push_back({"prog", "-b", "v", "x", "y"}); break;
+        case 2: lines.push_back({"prog", "-c"}); break;
+        case 3: lines.push_back({"prog"}); break;
+        }
+    }
+    std::vector<int> argcs;
+    std::vector<const char* const*> argvs;
+    for (const auto& l : lines) {
+        argcs.push_back(l.size());
+        argvs.push_back(l.data());
+    }
+
+    for (unsigned threads : {1u, 4u}) {
+        argparse::batch_result r;
+        s.parse_batch(lines.size(), argcs.data(), argvs.data(), r, threads);
+        ASSERT(r.size() == lines.size());
+        for (size_t i = 0; i < lines.size(); ++i) {
+            ASSERT(strcmp(r.progname(i), "prog") == 0);
+            switch (i % 4) {
+            case 0:
+                ASSERT(r.errors()[i] == true);
+                ASSERT(r.is_set(i, a) && !r.is_set(i, b));
+                ASSERT(r.args(i).size() == 1 && strcmp(r.args(i)[0], "x") == 0);
+                break;
+            case 1:
+                ASSERT(r.errors()[i] == true);
+                ASSERT(!r.is_set(i, a) && strcmp(r.value(i, b), "v") == 0);
+                ASSERT(r.args(i).size() == 2 && strcmp(r.args(i)[1], "y") == 0);
+                break;
+            case 2:
+                ASSERT(r.errors()[i] == false);
+                ASSERT(r.errors()[i].type() == err_t::unknown_option);
+                break;
+            case 3:
+                ASSERT(r.errors()[i] == true);
+                ASSERT(!r.is_set(i, a) && r.args(i).size() == 0);
+                break;
+            }
+        }
+    }
+}
+
+TEST {
+    // Rejected occurrences in collect mode, followed by accepted ones.
+    argparse::parser p;
+    auto f = p.flag("flag");
+    auto n = p.int_param('n');
+    auto s = p.compile();
+    const char* argv[] = {"prog", "--flag=1", "-n", "x", "--flag", "-n", "2", "arg"};
+    std::vector<int> argcs(200, 8);
+    std::vector<const char* const*> argvs(200, argv);
+
+    argparse::batch_result r;
+    for (unsigned threads : {1u, 3u, 1u}) {
+        s.parse_batch(200, argcs.data(), argvs.data(), r, threads, argparse::collect_errors);
+        for (std::size_t i = 0; i < 200; ++i) {
+            ASSERT(r.errors()[i].type() == err_t::unexpected_argument);
+            ASSERT(r.count(i, f) == 1 && r.position(i, f).index == 4);
+            ASSERT(r.count(i, n) == 1 && r.value(i, n) == 2 && r.position(i, n).index == 5);
+            ASSERT(r.args(i).size() == 1 && strcmp(r.args(i)[0], "arg") == 0);
+        }
+    }
+}
+
+// positional arguments view
+
+TEST {
+    argparse::parser p;
+    p.flag('a');
+    p.param('b');
+    const char* argv[] = {"prog", "w", "x", "-a", "y", "-b", "v", "z", "--", "-a", "-b"};
+    ASSERT(p.parse(11, argv) == true);
+
+    auto args = p.args();
+    const char* expected[] = {"w", "x", "y", "z", "-a", "-b"};
+    const size_t index[] = {1, 2, 4, 7, 9, 10};
+    ASSERT(args.size() == 6);
+    ASSERT(!args.empty());
+    for (size_t i = 0; i < 6; ++i) {
+        ASSERT(strcmp(args[i], expected[i]) == 0);
+        ASSERT(args.index(i) == index[i]);
+    }
+    size_t i = 0;
+    for (const char* arg : args)
+        ASSERT(strcmp(arg, expected[i++]) == 0);
+    ASSERT(i == 6);
+}
+
+// stop at first argument
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto b = p.param({'b', "opt-b"});
+    const char* argv[] = {"prog", "-a", "--opt-b", "x", "cmd", "-b", "--unknown", nullptr};
+    ASSERT(p.parse(7, argv, argparse::stop_at_first_arg) == true);
+    ASSERT(a.is_set());
+    ASSERT(strcmp(*b, "x") == 0);
+    auto args = p.args();
+    ASSERT(args.size() == 3);
+    ASSERT(args.data() == &argv[4]);
+    ASSERT(strcmp(args[0], "cmd") == 0);
+    ASSERT(strcmp(args[2], "--unknown") == 0);
+    ASSERT(args.data()[3] == nullptr);
+}
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto s = p.compile();
+    argparse::result r;
+
+    const char* argv1[] = {"prog", "-", "-a"};
+    ASSERT(s.parse(3, argv1, r, argparse::stop_at_first_arg) == true);
+    ASSERT(!r.is_set(a));
+    ASSERT(r.args().size() == 2 && r.args().data() == &argv1[1]);
+
+    const char* argv2[] = {"prog", "-a", "--", "-a"};
+    ASSERT(s.parse(4, argv2, r, argparse::stop_at_first_arg) == true);
+    ASSERT(r.is_set(a));
+    ASSERT(r.args().size() == 1 && strcmp(r.args()[0], "-a") == 0);
+
+    const char* argv3[] = {"prog", "-a"};
+    ASSERT(s.parse(2, argv3, r, argparse::stop_at_first_arg) == true);
+    ASSERT(r.args().empty() && r.args().data() == nullptr);
+
+    argparse::parser p2;
+    p2.flag('a');
+    ASSERT(p2.parse(2, argv3, argparse::stop_at_first_arg) == true);
+    ASSERT(p2.args().data() == nullptr);
+}
+
+TEST {
+    // The rest of argv is taken as a single run, however long it is.
+    std::vector<const char*> argv(100000, "arg");
+    argv[0] = "prog";
+    argv[1] = "-a";
+    argv[3] = "--";
+    argv.push_back(nullptr);
+    const int argc = static_cast<int>(argv.size()) - 1;
+    argparse::parser p;
+    auto a = p.flag('a');
+    ASSERT(p.parse(argc, argv.data(), argparse::stop_at_first_arg) == true);
+    ASSERT(a.is_set() && p.args().size() == argv.size() - 3);
+    ASSERT(p.args().data() == &argv[2] && p.args().data()[argc - 2] == nullptr);
+
+    argparse::result r;
+    ASSERT(p.compile().parse(argc - 2, argv.data() + 2, r) == true);
+    ASSERT(r.args().size() == argv.size() - 5);
+    ASSERT(r.args().data() == &argv[4]);
+
+    // One run is enough for a static result.
+    argparse::static_result<4, 1> sr;
+    ASSERT(static_opts.parse(argc, argv.data(), sr, argparse::stop_at_first_arg) == true);
+    ASSERT(sr.args().size() == argv.size() - 3 && sr.args().data() == &argv[2]);
+}
+
+TEST {
+    argparse::static_result<4, 1> r;
+    const char* argv[] = {"prog", "-b", "x", "-a", "y", "-c"};
+    ASSERT(static_opts.parse(6, argv, r, argparse::stop_at_first_arg) == true);
+    ASSERT(r.is_set(1) && !r.is_set(0));
+    ASSERT(r.args().size() == 4);
+}
+
+// response files
+
+/// File in the temporary directory, removed when it goes out of scope.
+struct temp_file
+{
+    temp_file()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        const char* dir = std::getenv("TMPDIR");
+        path = std::string(dir != nullptr && *dir != '\0' ? dir : "/tmp") + "/argparse-test-XXXXXX";
+        int fd = mkstemp(&path[0]);
+        ASSERT(fd != -1);
+        close(fd);
+#else
+        char buf[L_tmpnam];
+        ASSERT(std::tmpnam(buf) != nullptr);
+        path = buf;
+#endif
+    }
+
+    ~temp_file() { std::remove(path.c_str()); }
+
+    temp_file(const temp_file&) = delete;
+    temp_file& operator=(const temp_file&) = delete;
+
+    void write(const std::string& data)
+    {
+        std::FILE* f = std::fopen(path.c_str(), "wb");
+        ASSERT(f != nullptr);
+        std::fwrite(data.data(), 1, data.size(), f);
+        std::fclose(f);
+    }
+
+    std::string path;
+};
+
+TEST {
+    temp_file inner, outer;
+    const std::string missing = "@" + inner.path + ".missing";
+    inner.write("-c 'two words'\n");
+    outer.write("-a \"x y\" a\\ b @" + inner.path + "\n\t" + missing + " 'it''s' \"\\\"q\\\"\"");
+    argparse::parser p;
+    auto a = p.param('a');
+    auto c = p.param('c');
+    std::string at = "@" + outer.path;
+    const char* argv[] = {"prog", at.c_str(), "--", at.c_str(), nullptr};
+    ASSERT(p.parse(4, argv, argparse::expand_response_files) == true);
+    ASSERT(strcmp(*a, "x y") == 0);
+    ASSERT(strcmp(*c, "two words") == 0);
+    auto args = p.args();
+    ASSERT(args.size() == 5);
+    ASSERT(strcmp(args[0], "a b") == 0);
+    ASSERT(args[1] == missing);
+    ASSERT(strcmp(args[2], "its") == 0);
+    ASSERT(strcmp(args[3], "\"q\"") == 0);
+    ASSERT(args[4] == argv[3]);
+}
+
+TEST {
+    // Exactly one page, no trailing whitespace, and a file referring to itself.
+    std::string data(4096, 'x');
+    data[0] = '-';
+    data[1] = 'b';
+    data[2] = ' ';
+    temp_file page, self;
+    page.write(data);
+    const std::string at1 = "@" + page.path, at2 = "@" + self.path;
+    self.write("y " + at2);
+    const char* argv[] = {"prog", at1.c_str(), at2.c_str()};
+
+    argparse::response_files rsp(3, argv);
+    ASSERT(rsp.argc() == 3 + argparse::response_files::max_depth + 1);
+    ASSERT(strlen(rsp.argv()[2]) == 4093);
+    ASSERT(rsp.argv()[rsp.argc() - 1] == at2);
+    ASSERT(rsp.argv()[rsp.argc()] == nullptr);
+
+    argparse::parser p;
+    auto b = p.param('b');
+    argparse::result r;
+    ASSERT(p.compile().parse(rsp.argc(), rsp.argv(), r) == true);
+    ASSERT(strlen(r.value(b, "")) == 4093);
+    ASSERT(r.args().size() == argparse::response_files::max_depth + 1);
+}
+
+// NUL separated buffers
+
+TEST {
+    static const char buf[] = "prog\0-a\0x\0--opt-b\0y\0-\0--\0-a\0";
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto b = p.param("opt-b");
+    ASSERT(p.parse(buf, sizeof(buf) - 1) == true);
+    ASSERT(strcmp(p.progname(), "prog") == 0);
+    ASSERT(a.is_set());
+    ASSERT(*b == &buf[18]);
+    auto args = p.args();
+    ASSERT(args.size() == 3);
+    ASSERT(args[0] == &buf[8]);
+    ASSERT(strcmp(args[1], "-") == 0);
+    ASSERT(strcmp(args[2], "-a") == 0);
+    // Split by "--", like in argv.
+    ASSERT(args.data() == nullptr);
+    ASSERT(args.index(0) == 2 && args.index(1) == 5 && args.index(2) == 7);
+}
+
+TEST {
+    // Arguments of a buffer are numbered like in argv, so they can be
+    // ordered against options.
+    static const char buf[] = "prog\0w\0-a\0x\0-b\0v\0y\0";
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto b = p.param('b');
+    ASSERT(p.parse(buf, sizeof(buf) - 1) == true);
+    auto args = p.args();
+    ASSERT(args.size() == 3);
+    ASSERT(args.index(0) == 1 && args.index(1) == 3 && args.index(2) == 6);
+    ASSERT(args.index(0) < a.position().index && a.position().index < args.index(1));
+    ASSERT(b.position().index == 4 && args.index(2) > b.position().index);
+    ASSERT(strcmp(args[2], "y") == 0);
+
+    auto s = p.compile();
+    argparse::result r;
+    ASSERT(s.parse(buf, sizeof(buf) - 1, r) == true);
+    ASSERT(r.args().index(1) == 3 && r.position(a).index == 2 && strcmp(r.args()[1], "x") == 0);
+}
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto b = p.param('b');
+    auto s = p.compile();
+    argparse::result r;
+
+    static const char buf1[] = "prog\0-b\0";
+    ASSERT(s.parse(buf1, sizeof(buf1) - 1, r).type() == err_t::missing_argument);
+
+    static const char buf2[] = "prog\0cmd\0-a\0";
+    ASSERT(s.parse(buf2, sizeof(buf2) - 1, r, argparse::stop_at_first_arg) == true);
+    ASSERT(!r.is_set(a));
+    ASSERT(strcmp(r.progname(), "prog") == 0);
+    ASSERT(r.args().size() == 2 && r.args().data()[0] == &buf2[5]);
+
+    // Copies have their own arguments of the buffer.
+    std::unique_ptr<argparse::result> r2(new argparse::result);
+    ASSERT(s.parse(buf2, sizeof(buf2) - 1, *r2, argparse::stop_at_first_arg) == true);
+    argparse::result copy = *r2;
+    argparse::result moved;
+    moved = std::move(*r2);
+    r2.reset();
+    ASSERT(copy.args().size() == 2 && copy.args()[0] == &buf2[5] && copy.args()[1] == &buf2[9]);
+    ASSERT(moved.args().size() == 2 && moved.args()[1] == &buf2[9]);
+
+    // Missing terminator of the last argument.
+    bool thrown = false;
+    try { s.parse(buf2, sizeof(buf2) - 2, r); } catch (const std::runtime_error&) { thrown = true; }
+    ASSERT(thrown);
+    thrown = false;
+    try { s.parse(buf2, 0, r); } catch (const std::runtime_error&) { thrown = true; }
+    ASSERT(thrown);
+}
+
+// command line strings
+
+TEST {
+    argparse::command_line cl("prog  -a \"x \\\"y\\\"\" 'a\\b'c\\ d\t\n--opt=\"\" ''");
+    ASSERT(cl.argc() == 6);
+    ASSERT(strcmp(cl.argv()[0], "prog") == 0);
+    ASSERT(strcmp(cl.argv()[1], "-a") == 0);
+    ASSERT(strcmp(cl.argv()[2], "x \"y\"") == 0);
+    ASSERT(strcmp(cl.argv()[3], "a\\bc d") == 0);
+    ASSERT(strcmp(cl.argv()[4], "--opt=") == 0);
+    ASSERT(strcmp(cl.argv()[5], "") == 0);
+    ASSERT(cl.argv()[6] == nullptr);
+
+    cl.split("   ");
+    ASSERT(cl.argc() == 0 && cl.argv()[0] == nullptr);
+    cl.split("a\\", 2);
+    ASSERT(cl.argc() == 1 && strcmp(cl.argv()[0], "a\\") == 0);
+}
+
+TEST {
+    // Special characters at every offset of blocks scanned in bulk.
+    const std::string plain = "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    for (std::size_t k = 0; k <= plain.size(); ++k) {
+        for (const char* special : {" ", "\t", "\"\"", "''", "\\x"}) {
+            std::string in = plain.substr(0, k) + special + plain.substr(k);
+            argparse::command_line cl(in.data(), in.size());
+            if (special[0] == ' ' || special[0] == '\t') {
+                ASSERT(cl.argc() == (k == 0 || k == plain.size() ? 1 : 2));
+                ASSERT(plain.substr(0, k) + plain.substr(k) == std::string(cl.argv()[0])
+                        + (cl.argc() == 2 ? cl.argv()[1] : ""));
+            } else {
+                ASSERT(cl.argc() == 1);
+                ASSERT(std::string(cl.argv()[0]) == plain.substr(0, k)
+                        + (special[0] == '\\' ? "x" : "") + plain.substr(k));
+            }
+        }
+    }
+
+    argparse::parser p;
+    auto a = p.param('a');
+    argparse::command_line cl("prog -a \"one two\" file");
+    ASSERT(p.parse(cl.argc(), cl.argv()) == true);
+    ASSERT(strcmp(*a, "one two") == 0);
+    ASSERT(p.args().size() == 1);
+}
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag("opt-a");
+    auto b = p.param("opt-b");
+    auto s = p.compile();
+    argparse::result r;
+
+    const char* argv1[] = {"prog", "--opt-b=x"};
+    ASSERT(s.parse(2, argv1, r) == true);
+    ASSERT(r.value(b, nullptr) == &argv1[1][8]);
+
+    const char* argv2[] = {"prog", "--opt-a=1"};
+    auto res = s.parse(2, argv2, r);
+    ASSERT(res.type() == err_t::unexpected_argument);
+    ASSERT(res.str() == "option '--opt-a' doesn't allow an argument");
+
+    const char* argv3[] = {"prog", "--opt-c=1"};
+    ASSERT(s.parse(2, argv3, r).str() == "unknown option '--opt-c', did you mean '--opt-a'?");
+    (void)a;
+}
+
+// typed params
+
+TEST {
+    argparse::parser p;
+    auto i = p.int_param('i');
+    auto f = p.float_param("float");
+    auto d = p.duration_param('d');
+    auto b = p.bytes_param("bytes");
+    auto u = p.int_param('u');
+    const char* argv[] = {"prog", "-i", "-9223372036854775808", "--float=-1.25e-3",
+        "-d", "1h30m0.5s", "--bytes", "1.5KiB", nullptr};
+    ASSERT(p.parse(8, argv) == true);
+    ASSERT(*i == INT64_MIN);
+    ASSERT(*f == -1.25e-3);
+    ASSERT(*d == std::chrono::minutes(90) + std::chrono::milliseconds(500));
+    ASSERT(*b == 1536);
+    ASSERT(!u.is_set() && u.value(7) == 7);
+}
+
+TEST {
+    argparse::parser p;
+    auto i = p.int_param('i');
+    auto f = p.float_param('f');
+    auto d = p.duration_param('d');
+    auto b = p.bytes_param('b');
+    auto s = p.compile();
+    argparse::result r;
+
+    auto ok = [&](const char* opt, const char* value) {
+        const char* argv[] = {"prog", opt, value};
+        return bool(s.parse(3, argv, r));
+    };
+
+    ASSERT(ok("-i", "9223372036854775807") && r.value(i) == INT64_MAX);
+    ASSERT(!ok("-i", "9223372036854775808"));
+    ASSERT(!ok("-i", "") && !ok("-i", "-") && !ok("-i", "1x") && !ok("-i", "+1"));
+
+    ASSERT(ok("-f", "0.1") && r.value(f) == 0.1);
+    ASSERT(ok("-f", "123456789012345678901234567890") && r.value(f) == 123456789012345678901234567890.0);
+    ASSERT(ok("-f", "1e-300") && r.value(f) == 1e-300);
+    ASSERT(ok("-f", ".5") && r.value(f) == 0.5);
+    ASSERT(ok("-f", "9007199254740993") && r.value(f) == 9007199254740992.0);
+    ASSERT(ok("-f", "1.7976931348623157e308") && r.value(f) == 1.7976931348623157e308);
+    ASSERT(ok("-f", "0e999") && r.value(f) == 0);
+    ASSERT(!ok("-f", "1e999") && !ok("-f", ".") && !ok("-f", "1,5") && !ok("-f", "nan"));
+
+    ASSERT(ok("-d", "250ms") && r.value(d) == std::chrono::milliseconds(250));
+    ASSERT(ok("-d", "30") && r.value(d) == std::chrono::seconds(30));
+    ASSERT(ok("-d", "-1.5us") && r.value(d) == std::chrono::nanoseconds(-1500));
+    ASSERT(ok("-d", "9223372036854775807ns") && r.value(d).count() == INT64_MAX);
+    ASSERT(ok("-d", "-9223372036854775808ns") && r.value(d).count() == INT64_MIN);
+    ASSERT(ok("-d", "2562047h47m16s854775807ns") && r.value(d).count() == INT64_MAX);
+    ASSERT(ok("-d", "9007199254740993ns") && r.value(d).count() == 9007199254740993);
+    ASSERT(ok("-d", "1e3ms") && r.value(d) == std::chrono::seconds(1));
+    ASSERT(!ok("-d", "9223372036854775808ns") && !ok("-d", "2562047h47m16s854775808ns"));
+    ASSERT(!ok("-d", "1h30") && !ok("-d", "s") && !ok("-d", "1x") && !ok("-d", "1000000000h"));
+
+    ASSERT(ok("-b", "64k") && r.value(b) == 65536);
+    ASSERT(ok("-b", "2GB") && r.value(b) == (std::uint64_t{2} << 30));
+    ASSERT(ok("-b", "18446744073709551615") && r.value(b) == UINT64_MAX);
+    ASSERT(!ok("-b", "16E") && !ok("-b", "1.5") && !ok("-b", "-1") && !ok("-b", "1KB2"));
+
+    const char* argv[] = {"prog", "-b", "1Q"};
+    auto res = s.parse(3, argv, r);
+    ASSERT(res.type() == err_t::invalid_value);
+    ASSERT(res.str() == "invalid value for option '-b'");
+}
+
+// list params
+
+TEST {
+    argparse::parser p;
+    auto inc = p.list_param('I');
+    auto ids = p.list_param("ids", nullptr, ',');
+    auto unused = p.list_param('u');
+    std::vector<std::string> dirs;
+    dirs.reserve(20);
+    std::vector<const char*> argv {"prog"};
+    for (int i = 0; i < 20; ++i) {
+        dirs.push_back("dir" + std::to_string(i));
+        argv.push_back("-I");
+        argv.push_back(dirs.back().c_str());
+        if (i == 5)
+            argv.push_back("--ids=1,,22");
+    }
+    argv.push_back("--ids");
+    argv.push_back("333,");
+    ASSERT(p.parse(argv.size(), argv.data()) == true);
+
+    auto v = inc.values();
+    ASSERT(v.size() == 20);
+    for (std::size_t i = 0; i < v.size(); ++i)
+        ASSERT(v[i] == dirs[i].c_str());
+    std::size_t n = 0;
+    for (const char* s : v)
+        ASSERT(s == dirs[n++].c_str());
+
+    auto w = ids.values();
+    ASSERT(w.size() == 5);
+    ASSERT(strcmp(w[0], "1") == 0);
+    ASSERT(strcmp(w[1], "") == 0);
+    ASSERT(strcmp(w[2], "22") == 0);
+    ASSERT(strcmp(w[3], "333") == 0);
+    ASSERT(strcmp(w[4], "") == 0);
+    ASSERT(!unused.is_set() && unused.values().empty());
+}
+
+TEST {
+    argparse::parser p;
+    auto a = p.list_param('a', nullptr, ':');
+    auto b = p.list_param('b');
+    auto s = p.compile();
+
+    std::vector<std::vector<const char*>> lines;
+    for (int i = 0; i < 300; ++i) {
+        if (i % 3 == 0)
+            lines.push_back({"prog", "-a", "x:y", "-b", "1", "-b", "2", "-b", "3", "-b", "4", "-b", "5", "-a", "z"});
+        else
+            lines.push_back({"prog", "-b", "q"});
+    }
+    std::vector<int> argcs;
+    std::vector<const char* const*> argvs;
+    for (const auto& l : lines) {
+        argcs.push_back(l.size());
+        argvs.push_back(l.data());
+    }
+
+    argparse::batch_result br;
+    s.parse_batch(lines.size(), argcs.data(), argvs.data(), br, 4);
+    for (std::size_t i = 0; i < lines.size(); ++i) {
+        auto va = br.values(i, a);
+        auto vb = br.values(i, b);
+        if (i % 3 == 0) {
+            ASSERT(va.size() == 3 && strcmp(va[0], "x") == 0 && strcmp(va[1], "y") == 0 && va[2] == lines[i][14]);
+            ASSERT(vb.size() == 5 && strcmp(vb[4], "5") == 0);
+        } else {
+            ASSERT(va.empty());
+            ASSERT(vb.size() == 1 && vb[0] == lines[i][2]);
+        }
+    }
+
+    argparse::result r;
+    ASSERT(s.parse(argcs[0], argvs[0], r) == true);
+    argparse::result copy = r;
+    ASSERT(copy.values(a).size() == 3 && strcmp(copy.values(a)[1], "y") == 0);
+    ASSERT(s.parse(argcs[1], argvs[1], r) == true);
+    ASSERT(r.values(a).empty() && r.values(b).size() == 1);
+}
+
+// counted flags
+
+TEST {
+    argparse::parser p;
+    auto v = p.counter({'v', "verbose"});
+    auto q = p.counter('q');
+    auto a = p.flag('a');
+    auto i = p.list_param('I');
+    const char* argv[] = {"prog", "-vvav", "--verbose", "-I", "x", "-avI", "y", nullptr};
+    ASSERT(p.parse(7, argv) == true);
+    ASSERT(*v == 5);
+    ASSERT(v.is_set() && !q.is_set() && *q == 0);
+    ASSERT(a.count() == 2 && *a);
+    ASSERT(i.count() == 2);
+
+    auto s = p.compile();
+    argparse::result r;
+    ASSERT(s.parse(7, argv, r) == true);
+    ASSERT(r.value(v) == 5 && r.count(a) == 2 && r.count(q) == 0);
+
+    argparse::batch_result br;
+    const int argcs[] = {7, 2};
+    const char* argv2[] = {"prog", "-q"};
+    const char* const* argvs[] = {argv, argv2};
+    s.parse_batch(2, argcs, argvs, br);
+    ASSERT(br.count(0, v) == 5 && br.count(1, v) == 0 && br.count(1, q) == 1);
+}
+
+TEST {
+    argparse::static_result<4> r;
+    const char* argv[] = {"prog", "-bb", "--opt-a", "-b"};
+    ASSERT(static_opts.parse(4, argv, r) == true);
+    ASSERT(r.count(0) == 1 && r.count(1) == 3 && r.count(2) == 0);
+}
+
+// positions
+
+TEST {
+    argparse::parser p;
+    auto inc = p.list_param("include");
+    auto exc = p.list_param("exclude");
+    auto a = p.flag('a');
+    auto b = p.flag('b');
+    auto c = p.flag('c');
+    const char* argv[] = {"prog", "--include", "x", "-ba", "--exclude=y", "file", "--include", "z", nullptr};
+    ASSERT(p.parse(8, argv) == true);
+
+    ASSERT(inc.position() == argparse::position(6, 0));
+    ASSERT(b.position() == argparse::position(3, 1));
+    ASSERT(a.position() == argparse::position(3, 2));
+    ASSERT(!c.position().valid());
+    ASSERT(b < a && a > b && exc < inc && c < b);
+    ASSERT(p.args().index(0) == 5);
+
+    const auto& occ = p.occurrences();
+    ASSERT(occ.size() == 5);
+    ASSERT(occ[0].id == inc.id() && occ[0].pos == argparse::position(1, 0));
+    ASSERT(occ[1].id == b.id() && occ[2].id == a.id());
+    ASSERT(occ[3].id == exc.id() && occ[3].pos.index == 4);
+    ASSERT(occ[4].id == inc.id() && occ[4].pos.index == 6);
+}
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto b = p.param('b');
+    auto s = p.compile();
+    argparse::result r;
+    const char* argv[] = {"prog", "-b", "x", "-a"};
+    ASSERT(s.parse(4, argv, r) == true);
+    ASSERT(r.position(b) < r.position(a));
+    ASSERT(r.occurrences().size() == 2 && r.occurrences()[1].id == a.id());
+
+    argparse::static_result<4> sr;
+    const char* argv2[] = {"prog", "-ab", "--opt-c", "x"};
+    ASSERT(static_opts.parse(4, argv2, sr) == true);
+    ASSERT(sr.position(3) == argparse::position(1, 1));
+    ASSERT(sr.position(1) == argparse::position(1, 2));
+    ASSERT(sr.position(2) == argparse::position(2, 0));
+}
+
+// error formatting and collecting
+
+TEST {
+    err_t e(err_t::unknown_option, "--opt-a=x");
+    char buf[64];
+    ASSERT(e.format(buf, sizeof(buf)) == 24);
+    ASSERT(strcmp(buf, "unknown option '--opt-a'") == 0);
+    ASSERT(e.format(buf, 8) == 24);
+    ASSERT(strcmp(buf, "unknown") == 0);
+    ASSERT(e.format(nullptr, 0) == 24);
+    ASSERT(err_t(err_t::missing_argument, 'a').str() == "option '-a' requires an argument");
+    ASSERT(err_t().str() == "ok");
+
+    std::string longname = "--" + std::string(200, 'x');
+    ASSERT(err_t(err_t::unknown_option, longname.c_str()).str() == "unknown option '" + longname + "'");
+}
+
+TEST {
+    argparse::parser p;
+    auto a = p.flag('a');
+    auto n = p.int_param('n');
+    auto f = p.flag("flag");
+    const char* argv[] = {"prog", "-xay", "--nope", "-n", "z", "--flag=1", "file", "-n", "3", "--flag", "-n", nullptr};
+    auto res = p.parse(11, argv, argparse::collect_errors);
+    ASSERT(res.type() == err_t::unknown_option && strcmp(res.optname(), "-x") == 0);
+    ASSERT(a.is_set() && *n == 3 && f.is_set());
+    ASSERT(p.args().size() == 1);
+
+    const auto& errs = p.errors();
+    ASSERT(errs.size() == 6 && errs.total() == 6);
+    ASSERT(strcmp(errs[0].optname(), "-x") == 0);
+    ASSERT(strcmp(errs[1].optname(), "-y") == 0);
+    ASSERT(errs[2].type() == err_t::unknown_option && strcmp(errs[2].optname(), "--nope") == 0);
+    ASSERT(errs[3].type() == err_t::invalid_value);
+    ASSERT(errs[4].type() == err_t::unexpected_argument);
+    ASSERT(errs[5].type() == err_t::missing_argument);
+}
+
+TEST {
+    argparse::parser p;
+    p.flag('a');
+    auto s = p.compile();
+    argparse::result r;
+    std::vector<const char*> argv {"prog"};
+    for (int i = 0; i < 20; ++i)
+        argv.push_back("-b");
+    ASSERT(s.parse(argv.size(), argv.data(), r, argparse::collect_errors) == false);
+    ASSERT(r.errors().size() == argparse::error_list::capacity && r.errors().total() == 20);
+    ASSERT(s.parse(argv.size(), argv.data(), r) == false);
+    ASSERT(r.errors().empty());
+
+    argparse::static_result<4, 1> sr;
+    const char* argv2[] = {"prog", "x", "-b", "y", "-e", "z"};
+    ASSERT(static_opts.parse(6, argv2, sr, argparse::collect_errors).type() == err_t::too_many_arguments);
+    ASSERT(sr.errors().size() == 3 && sr.is_set(1) && sr.args().size() == 1);
+}
+
+// "did you mean" suggestions
+
+TEST {
+    auto suggest = [](const char* arg) -> std::string {
+        argparse::parser p;
+        p.flag("verbose");
+        p.flag("version");
+        p.param("output");
+        p.flag('q');
+        const char* argv[] = {"prog", arg};
+        auto res = p.parse(2, argv);
+        return res.suggestion() != nullptr ? res.suggestion() : "";
+    };
+    ASSERT(suggest("--verbos") == "verbose");
+    ASSERT(suggest("--vresion") == "version");
+    ASSERT(suggest("--verson=1") == "version");
+    ASSERT(suggest("--outptu") == "output");
+    ASSERT(suggest("--versio") == "version");
+    ASSERT(suggest("--xyz") == "");
+    ASSERT(suggest("--v") == "");
+    ASSERT(suggest("-x") == "");
+    ASSERT(suggest(("--" + std::string(100, 'v')).c_str()) == "");
+
+    // Ties go to the option registered first.
+    argparse::parser p;
+    p.flag("verbose");
+    p.flag("version");
+    p.flag('o', "versiox");
+    const char* argv[] = {"prog", "--versiob"};
+    auto res = p.parse(2, argv);
+    ASSERT(res.type() == err_t::unknown_option && strcmp(res.suggestion(), "version") == 0);
+    ASSERT(res.str() == "unknown option '--versiob', did you mean '--version'?");
+}
+
+TEST {
+    std::vector<std::string> names;
+    names.reserve(1000);
+    argparse::parser p;
+    for (int i = 0; i < 1000; ++i) {
+        names.push_back("option-" + std::to_string(i));
+        p.flag(names.back().c_str());
+    }
+    auto s = p.compile();
+    argparse::result r;
+    const char* argv[] = {"prog", "--optoin-517"};
+    auto res = s.parse(2, argv, r);
+    ASSERT(res.suggestion() != nullptr && strcmp(res.suggestion(), "option-517") == 0);
+
+    argparse::static_result<4> sr;
+    const char* argv2[] = {"prog", "--opt-x"};
+    res = static_opts.parse(2, argv2, sr);
+    ASSERT(res.suggestion() != nullptr && strcmp(res.suggestion(), "opt-a") == 0);
+}
+
+// help page
+
+TEST {
+    argparse::parser p;
+    p.flag({'a', "all"}, "Show all entries, including the ones starting with a dot.");
+    p.param("output", "Write to FILE.", "FILE");
+    p.int_param('n', "Number of lines");
+    p.category("Empty");
+    p.category("Advanced");
+    auto t = p.duration_param("a-very-long-option-name", "Timeout.\nSecond line.");
+    auto i = p.list_param({'I', "include"}, "Include directory", ',', "DIR");
+    auto v = p.counter('v');
+    p.category("Trailing");
+
+    ASSERT(t.metavar() == std::string("DURATION") && i.metavar() == std::string("DIR"));
+    ASSERT(v.metavar() == nullptr);
+
+    const std::string& page = p.help(50);
+    ASSERT(page ==
+        "  -a, --all          Show all entries, including\n"
+        "                     the ones starting with a dot.\n"
+        "      --output FILE  Write to FILE.\n"
+        "  -n INT             Number of lines\n"
+        "\n"
+        "Advanced:\n"
+        "      --a-very-long-option-name DURATION\n"
+        "                     Timeout.\n"
+        "                     Second line.\n"
+        "  -I, --include DIR  Include directory\n"
+        "  -v\n");
+
+    // Cached until more options are registered.
+    ASSERT(&p.help(50) == &page && p.help(50).data() == page.data());
+    ASSERT(p.help(200).find("including the ones starting with a dot.\n") != std::string::npos);
+    p.flag('z', "Last");
+    ASSERT(p.help(200).find("Trailing:\n  -z") != std::string::npos);
+
+    std::FILE* f = std::tmpfile();
+    ASSERT(f != nullptr);
+    ASSERT(p.print_help(fileno(f), 200));
+    std::string out(p.help(200).size() + 1, '\0');
+    std::rewind(f);
+    ASSERT(std::fread(&out[0], 1, out.size(), f) == out.size() - 1);
+    out.pop_back();
+    ASSERT(out == p.help(200));
+    std::fclose(f);
+}
+
+// subcommands
+
+TEST {
+    int built = 0, cleaned = 0;
+    argparse::parser p;
+    auto v = p.flag('v');
+    argparse::parser::int_param_t jobs;
+    argparse::parser::flag_t force;
+    p.command("build", [&](argparse::parser& sub) { ++built; jobs = sub.int_param('j'); }, "Build targets");
+    p.command("clean", [&](argparse::parser& sub) { ++cleaned; force = sub.flag('f'); });
+
+    const char* argv[] = {"prog", "-v", "build", "-j", "4", "target", "-v"};
+    ASSERT(p.parse(7, argv) == false);
+    ASSERT(built == 1 && cleaned == 0);
+    ASSERT(v.is_set() && *jobs == 4 && !force);
+    ASSERT(strcmp(p.command_name(), "build") == 0);
+    ASSERT(p.args().size() == 5 && strcmp(p.args()[0], "build") == 0);
+
+    // The "-v" after the command belongs to the command, which doesn't know it.
+    const auto* sub = p.subparser();
+    ASSERT(sub != nullptr && strcmp(sub->progname(), "build") == 0);
+    ASSERT(sub->args().size() == 1 && strcmp(sub->args()[0], "target") == 0);
+
+    argparse::parser p2;
+    p2.command("build", [&](argparse::parser&) { ++built; });
+    p2.command("clean", [&](argparse::parser&) { ++cleaned; });
+    const char* argv2[] = {"prog", "biuld"};
+    auto res = p2.parse(2, argv2);
+    ASSERT(res.type() == err_t::unknown_command && built == 1);
+    ASSERT(res.str() == "unknown command 'biuld', did you mean 'build'?");
+    ASSERT(p2.command_name() == nullptr && p2.subparser() == nullptr);
+
+    argparse::parser p3;
+    p3.flag('v');
+    p3.command("build", [&](argparse::parser&) { ++built; });
+    const char* argv3[] = {"prog", "-v"};
+    ASSERT(p3.parse(2, argv3) == true);
+    ASSERT(p3.command_name() == nullptr && built == 1);
+}
+
+TEST {
+    // With collect_errors, errors of the command go to the parent too.
+    argparse::parser p;
+    p.flag('v');
+    p.command("build", [](argparse::parser& sub) { sub.int_param('j'); });
+    const char* argv[] = {"prog", "-x", "build", "-y", "-j", "z"};
+    auto res = p.parse(6, argv, argparse::collect_errors);
+    ASSERT(res.type() == err_t::unknown_option && strcmp(res.optname(), "-x") == 0);
+    ASSERT(p.subparser()->errors().size() == 2);
+    ASSERT(p.errors().size() == 3 && p.errors().total() == 3);
+    ASSERT(strcmp(p.errors()[1].optname(), "-y") == 0);
+    ASSERT(p.errors()[2].type() == err_t::invalid_value);
+
+    argparse::error_list a, b;
+    for (int i = 0; i < 20; ++i)
+        b.add(res);
+    a.add(res);
+    a.add(b);
+    ASSERT(a.size() == argparse::error_list::capacity && a.total() == 21);
+}
+
+TEST {
+    // Schemas leave the command and its arguments to the caller.
+    int built = 0;
+    argparse::parser p;
+    auto v = p.flag('v');
+    p.command("build", [&](argparse::parser& sub) { ++built; sub.flag('j'); });
+    auto s = p.compile();
+    argparse::result r;
+    const char* argv[] = {"prog", "-v", "build", "-j"};
+    ASSERT(s.parse(4, argv, r) == true);
+    ASSERT(r.is_set(v) && built == 0);
+    ASSERT(r.args().size() == 2 && r.args().data() == &argv[2]);
+}
+
+TEST {
+    std::vector<std::string> names;
+    names.reserve(200);
+    std::vector<int> calls(200);
+    argparse::parser p;
+    for (int i = 0; i < 200; ++i) {
+        names.push_back("cmd-" + std::to_string(i));
+        p.command(names.back().c_str(), [&calls, i](argparse::parser&) { ++calls[i]; });
+    }
+    // Later registrations replace earlier ones.
+    argparse::parser::list_param_t items;
+    p.command("cmd-137", [&](argparse::parser& sub) {
+        sub.command("add", [&](argparse::parser& sub2) { items = sub2.list_param('i'); });
+    });
+
+    const char* buf = "prog\0cmd-137\0add\0-i\0x\0-i\0y\0";
+    ASSERT(p.parse(buf, 27) == true);
+    for (int c : calls)
+        ASSERT(c == 0);
+    ASSERT(strcmp(p.command_name(), "cmd-137") == 0);
+    ASSERT(strcmp(p.subparser()->command_name(), "add") == 0);
+    ASSERT(items.values().size() == 2 && strcmp(items.values()[1], "y") == 0);
+
+    argparse::parser p2;
+    p2.flag('a', "Flag");
+    p2.command("remote", [](argparse::parser&) {}, "Manage remotes");
+    p2.command("status", [](argparse::parser&) {});
+    ASSERT(p2.help() ==
+        "  -a      Flag\n"
+        "\n"
+        "Commands:\n"
+        "  remote  Manage remotes\n"
+        "  status\n");
+}
+
+// completion
+
+TEST {
+    int built = 0;
+    argparse::parser p;
+    p.flag({'v', "verbose"});
+    p.flag("version");
+    p.param({'o', "output"});
+    p.counter('q');
+    p.command("build", [&](argparse::parser& sub) { ++built; sub.flag("force"); sub.int_param('j', "jobs"); });
+    p.command("bench", [](argparse::parser&) {});
+    p.command("clean", [](argparse::parser&) {});
+
+    auto complete = [&](std::vector<const char*> argv) {
+        std::vector<const char*> out;
+        std::size_t n = p.complete(argv.size(), argv.data(), out);
+        ASSERT(n == out.size());
+        std::string s;
+        for (const char* w : out)
+            s += std::string(w) + " ";
+        return s;
+    };
+    ASSERT(complete({"prog", "--ver"}) == "--verbose --version ");
+    ASSERT(complete({"prog", "--verb"}) == "--verbose ");
+    ASSERT(complete({"prog", "-"}) == "--output --verbose --version -o -q -v ");
+    ASSERT(complete({"prog", "--x"}) == "");
+    ASSERT(complete({"prog", "b"}) == "bench build ");
+    ASSERT(complete({"prog", ""}) == "bench build clean ");
+    ASSERT(complete({"prog", "-o", ""}) == "");
+    ASSERT(complete({"prog", "-qo", ""}) == "");
+    ASSERT(complete({"prog", "--output=x", "cl"}) == "clean ");
+    ASSERT(complete({"prog", "--output=x"}) == "");
+    ASSERT(complete({"prog", "--", "-"}) == "");
+    ASSERT(complete({"prog"}) == "bench build clean ");
+    ASSERT(built == 0);
+
+    ASSERT(complete({"prog", "-v", "build", "--f"}) == "--force ");
+    ASSERT(complete({"prog", "build", "-j", "4", "-"}) == "--force -j ");
+    ASSERT(complete({"prog", "build", "x"}) == "");
+    ASSERT(complete({"prog", "nope", "-"}) == "");
+    ASSERT(built == 1);
+
+    // Registering invalidates the names.
+    p.flag("verify");
+    ASSERT(complete({"prog", "--veri"}) == "--verify ");
+
+    std::FILE* f = std::tmpfile();
+    ASSERT(f != nullptr);
+    const char* argv[] = {"prog", "__complete", "--ver"};
+    ASSERT(p.handle_completion(3, argv, fileno(f)));
+    char buf[64] = {0};
+    std::rewind(f);
+    ASSERT(std::fread(buf, 1, sizeof(buf) - 1, f) == 29);
+    ASSERT(strcmp(buf, "--verbose\n--verify\n--version\n") == 0);
+    std::fclose(f);
+    const char* argv2[] = {"prog", "--verbose"};
+    ASSERT(p.handle_completion(2, argv2, 1) == false);
+
+    ASSERT(argparse::parser::completion_script(argparse::shell::bash, "my-prog").find(
+        "complete -o default -F _argparse_complete_my_prog my-prog\n") != std::string::npos);
+    ASSERT(argparse::parser::completion_script(argparse::shell::zsh, "my-prog").find("#compdef my-prog\n") == 0);
+    ASSERT(argparse::parser::completion_script(argparse::shell::fish, "my-prog").find(
+        "complete -c my-prog -a '(_argparse_complete_my_prog)'\n") != std::string::npos);
+}
+
+// abbreviations
+
+TEST {
+    auto parse = [](std::vector<const char*> argv, unsigned flags, argparse::parser::param_t* out = nullptr) {
+        argparse::parser p;
+        p.flag("verbose");
+        p.flag("version");
+        auto o = p.param("output");
+        p.flag("out");
+        err_t res = p.parse(argv.size(), argv.data(), flags);
+        if (out != nullptr)
+            *out = o;
+        return res;
+    };
+    const unsigned abbrev = argparse::allow_abbreviations;
+    ASSERT(parse({"prog", "--verb"}, 0).type() == err_t::unknown_option);
+    ASSERT(parse({"prog", "--verb"}, abbrev) == true);
+    ASSERT(parse({"prog", "--version"}, abbrev) == true);
+    ASSERT(parse({"prog", "--out"}, abbrev) == true);
+    ASSERT(parse({"prog", "--x"}, abbrev).type() == err_t::unknown_option);
+    ASSERT(parse({"prog", "--=x"}, abbrev).type() == err_t::unknown_option);
+
+    argparse::parser::param_t o;
+    ASSERT(parse({"prog", "--outp=x"}, abbrev, &o) == true);
+    ASSERT(strcmp(*o, "x") == 0);
+    ASSERT(parse({"prog", "--outp", "y"}, abbrev, &o) == true);
+    ASSERT(strcmp(*o, "y") == 0);
+
+    ASSERT(parse({"prog", "--o"}, abbrev).ncandidates() == 2);
+
+    // Candidates point into the parser.
+    argparse::parser p;
+    p.flag("verbose");
+    p.flag("version");
+    const char* argv[] = {"prog", "--ver=1"};
+    auto res = p.parse(2, argv, abbrev);
+    ASSERT(res.type() == err_t::ambiguous_option && res.ncandidates() == 2);
+    ASSERT(strcmp(res.candidates(), "--verbose") == 0);
+    ASSERT(strcmp(res.candidates() + 10, "--version") == 0);
+    ASSERT(res.str() == "option '--ver' is ambiguous; possibilities: '--verbose' '--version'");
+}
+
+TEST {
+    argparse::parser p;
+    auto v = p.flag("verbose");
+    p.flag("version");
+    auto c = p.counter("count");
+    auto s = p.compile();
+    argparse::result r;
+    const char* argv[] = {"prog", "--verb", "--c", "--co", "--ver", "--count"};
+    auto res = s.parse(6, argv, r, argparse::allow_abbreviations | argparse::collect_errors);
+    ASSERT(res.type() == err_t::ambiguous_option && strcmp(res.optname(), "--ver") == 0);
+    ASSERT(r.is_set(v) && r.count(c) == 3 && r.errors().size() == 1);
+
+    // The names are built once, by whichever thread needs them first.
+    auto s2 = p.compile();
+    std::vector<int> argcs(64, 2);
+    std::vector<const char* const*> argvs(64, argv);
+    argparse::batch_result br;
+    s2.parse_batch(64, argcs.data(), argvs.data(), br, 4, argparse::allow_abbreviations);
+    for (std::size_t i = 0; i < 64; ++i)
+        ASSERT(br.errors()[i] == true && br.is_set(i, v));
+
+    argparse::static_result<4> sr;
+    const char* argv2[] = {"prog", "--opt-a"};
+    ASSERT(static_opts.parse(2, argv2, sr, argparse::allow_abbreviations) == true);
+    const char* argv3[] = {"prog", "--opt"};
+    ASSERT(static_opts.parse(2, argv3, sr, argparse::allow_abbreviations).type() == err_t::unknown_option);
+
+    // An empty name is not an abbreviation, even of the only long option.
+    argparse::parser p2;
+    auto only = p2.param("only");
+    const char* argv4[] = {"prog", "--=x"};
+    ASSERT(p2.compile().parse(2, argv4, r, argparse::allow_abbreviations).type() == err_t::unknown_option);
+    ASSERT(p2.parse(2, argv4, argparse::allow_abbreviations).type() == err_t::unknown_option);
+    ASSERT(!only.is_set());
+}
+
+// constraints
+
+TEST {
+    // Names in errors point into the parser, so parsers are kept.
+    std::vector<std::unique_ptr<argparse::parser>> parsers;
+    auto parse = [&parsers](std::vector<const char*> argv) {
+        parsers.emplace_back(new argparse::parser);
+        auto& p = *parsers.back();
+        auto in = p.param("input");
+        auto json = p.flag("json");
+        auto yaml = p.flag("yaml");
+        auto user = p.param("user");
+        auto pass = p.param("password");
+        auto a = p.flag('a');
+        auto b = p.flag('b');
+        p.required(in);
+        p.exclusive({json, yaml});
+        p.depends(user, {pass});
+        p.exactly_one({a, b});
+        return p.parse(argv.size(), argv.data());
+    };
+    ASSERT(parse({"prog", "--input=x", "-a"}) == true);
+    ASSERT(parse({"prog", "--input=x", "-b", "--json", "--user=u", "--password=p"}) == true);
+
+    auto res = parse({"prog", "-a"});
+    ASSERT(res.type() == err_t::missing_option && strcmp(res.optname(), "--input") == 0);
+    ASSERT(res.str() == "option '--input' is required");
+
+    res = parse({"prog", "--input=x", "-a", "--yaml", "--json"});
+    ASSERT(res.type() == err_t::conflicting_options);
+    ASSERT(strcmp(res.optname(), "--json") == 0 && strcmp(res.other(), "--yaml") == 0);
+    ASSERT(res.str() == "options '--json' and '--yaml' can't be used together");
+
+    res = parse({"prog", "--input=x", "-a", "--user=u"});
+    ASSERT(res.type() == err_t::missing_option && strcmp(res.other(), "--user") == 0);
+    ASSERT(res.str() == "option '--password' is required by '--user'");
+    ASSERT(parse({"prog", "--input=x", "-a", "--password=p"}) == true);
+
+    res = parse({"prog", "--input=x"});
+    ASSERT(res.type() == err_t::missing_option && res.ncandidates() == 2);
+    ASSERT(res.str() == "one of '-a' '-b' is required");
+    ASSERT(parse({"prog", "--input=x", "-ab"}).str() == "options '-a' and '-b' can't be used together");
+    ASSERT(res.suggestion() == nullptr);
+
+    // Constraints are not checked after a parse error.
+    ASSERT(parse({"prog", "--nope"}).type() == err_t::unknown_option);
+}
+
+TEST {
+    argparse::parser p;
+    auto in = p.param("input");
+    auto json = p.flag("json");
+    auto yaml = p.flag("yaml");
+    p.required(in);
+    p.exclusive({json, yaml});
+    const char* argv[] = {"prog", "--json", "--yaml", "--nope"};
+    auto res = p.parse(4, argv, argparse::collect_errors);
+    ASSERT(res.type() == err_t::unknown_option);
+    ASSERT(p.errors().size() == 3);
+    ASSERT(p.errors()[1].type() == err_t::missing_option);
+    ASSERT(p.errors()[2].type() == err_t::conflicting_options);
+
+    // Schemas check the same constraints, with more than 64 options.
+    argparse::parser p2;
+    std::vector<std::string> names;
+    names.reserve(100);
+    for (int i = 0; i < 100; ++i) {
+        names.push_back("opt-" + std::to_string(i));
+        p2.flag(names.back().c_str());
+    }
+    auto x = p2.flag("x");
+    auto y = p2.flag("y");
+    p2.depends(x, {y});
+    auto s = p2.compile();
+    argparse::result r;
+    const char* argv2[] = {"prog", "--x"};
+    res = s.parse(2, argv2, r);
+    ASSERT(res.type() == err_t::missing_option && strcmp(res.optname(), "--y") == 0);
+    const char* argv3[] = {"prog", "--x", "--y"};
+    ASSERT(s.parse(3, argv3, r) == true);
+
+    std::vector<int> argcs {2, 3};
+    std::vector<const char* const*> argvs {argv2, argv3};
+    argparse::batch_result br;
+    s.parse_batch(2, argcs.data(), argvs.data(), br, 2);
+    ASSERT(br.errors()[0].type() == err_t::missing_option && br.errors()[1] == true);
+}
+
+TEST {
+    // Constraints on shadowed options could never be satisfied.
+    argparse::parser p;
+    auto a = p.flag({'a', "all"});
+    auto b = p.flag('b');
+    p.required(a);
+    p.exclusive({a, b});
+    auto a2 = p.flag("all");
+    // Only "--all" was taken over, "-a" still works.
+    auto s = p.compile();
+    argparse::result r;
+    const char* argv[] = {"prog", "-a", "--all"};
+    ASSERT(s.parse(3, argv, r) == true);
+    ASSERT(r.is_set(a) && r.is_set(a2));
+
+    p.flag('a');
+    bool thrown = false;
+    try { p.compile(); } catch (const std::logic_error&) { thrown = true; }
+    ASSERT(thrown);
+    thrown = false;
+    try { p.parse(3, argv); } catch (const std::logic_error&) { thrown = true; }
+    ASSERT(thrown);
+}
+
+TEST {
+    // Occurrences rejected in collect mode don't count as present.
+    argparse::parser p;
+    auto f = p.flag("flag");
+    auto n = p.int_param('n');
+    p.required(f);
+    p.required(n);
+    const char* argv[] = {"prog", "--flag=1", "-n", "x"};
+    auto res = p.parse(4, argv, argparse::collect_errors);
+    ASSERT(res.type() == err_t::unexpected_argument);
+    ASSERT(p.errors().size() == 4);
+    ASSERT(p.errors()[1].type() == err_t::invalid_value);
+    ASSERT(p.errors()[2].type() == err_t::missing_option && strcmp(p.errors()[2].optname(), "--flag") == 0);
+    ASSERT(p.errors()[3].type() == err_t::missing_option && strcmp(p.errors()[3].optname(), "-n") == 0);
+    ASSERT(!f.is_set() && !f.position().valid() && !n.position().valid());
+    ASSERT(p.occurrences().empty());
+
+    auto s = p.compile();
+    argparse::result r;
+    const char* argv2[] = {"prog", "--flag=1", "-n", "x", "-n", "2"};
+    res = s.parse(6, argv2, r, argparse::collect_errors);
+    ASSERT(r.errors().size() == 3 && r.errors()[2].type() == err_t::missing_option);
+    ASSERT(r.occurrences().size() == 1 && r.position(n).index == 4);
+}
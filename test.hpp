@@ -191,15 +191,21 @@ struct test_category : test_opt
 struct test_case_registry
 {
     using test_t = void (*)(TEST_CASE_ARGS);
+    using plain_t = void (*)();
 
     struct item_t {
         const char* file;
         size_t line;
         test_t test;
+        plain_t plain;
     };
 
     static void add(const char* file, size_t line, test_t test) {
-        instance().push_back({ file, line, test });
+        instance().push_back({ file, line, test, nullptr });
+    }
+
+    static void add(const char* file, size_t line, plain_t plain) {
+        instance().push_back({ file, line, nullptr, plain });
     }
 
     static int run() {
@@ -212,8 +218,12 @@ struct test_case_registry
             t.line = c.line;
             fprintf(stderr, ".");
             try {
-                c.test(t.argv, t.opts, t.args, t.error);
-                t.run();
+                if (c.plain != nullptr) {
+                    c.plain();
+                } else {
+                    c.test(t.argv, t.opts, t.args, t.error);
+                    t.run();
+                }
             } catch (const test_assert_error& e) {
                 fprintf(stderr, "FAIL\n%s:%ld: Assertion failed in test case #%ld\n%s\n",
                         t.file, t.line, t.id, e.what());
@@ -244,4 +254,13 @@ struct dummy_t {};
     }(); \
     static void CAT(test_case_, __LINE__)(TEST_CASE_ARGS)
 
+/// Test with its own setup and checks, for things that don't fit TEST_CASE.
+#define TEST \
+    static void CAT(test_, __LINE__)(); \
+    static dummy_t CAT(test_dummy_, __LINE__) = []() -> dummy_t { \
+        test_case_registry::add(__FILE__, __LINE__, CAT(test_, __LINE__)); \
+        return {}; \
+    }(); \
+    static void CAT(test_, __LINE__)()
+
 #endif // ARGPARSE_TEST_HPP